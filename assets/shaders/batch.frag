@@ -0,0 +1,11 @@
+#version 460 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+in vec4 VertexColor;
+
+uniform sampler2D image;
+
+void main() {
+    FragColor = texture(image, TexCoord) * VertexColor;
+}
\ No newline at end of file
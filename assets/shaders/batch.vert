@@ -0,0 +1,31 @@
+#version 460 core
+#ifdef PACKED_POSITIONS
+layout (location = 0) in vec2 aPos;
+#else
+layout (location = 0) in vec3 aPos;
+#endif
+layout (location = 1) in vec2 aTexCoord;
+layout (location = 2) in vec4 aColor;
+#ifdef PACKED_POSITIONS
+layout (location = 3) in float aDepth;
+#endif
+
+out vec2 TexCoord;
+out vec4 VertexColor;
+
+#ifdef PACKED_POSITIONS
+uniform vec2 positionOrigin;
+uniform float positionScale;
+#endif
+
+#include "include/camera.glsl"
+
+void main() {
+#ifdef PACKED_POSITIONS
+    gl_Position = toClipSpace(vec3(positionOrigin + aPos * positionScale, aDepth));
+#else
+    gl_Position = toClipSpace(aPos);
+#endif
+    TexCoord = aTexCoord;
+    VertexColor = aColor;
+}
\ No newline at end of file
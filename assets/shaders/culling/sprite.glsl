@@ -0,0 +1,26 @@
+struct GpuSprite {
+    vec2 position;
+    vec2 origin;
+    vec2 size;
+    float rotation;
+    float depth;
+    vec4 uv;
+    vec4 color;
+};
+
+layout (std430, binding = 4) readonly buffer Sprites {
+    GpuSprite sprites[];
+};
+
+const vec2 corners[6] = vec2[](
+    vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(0.0, 1.0),
+    vec2(1.0, 0.0), vec2(1.0, 1.0), vec2(0.0, 1.0)
+);
+
+// Same transformation as the model matrix of ObjectDrawer::drawTexture
+vec2 spriteCorner(GpuSprite sprite, vec2 corner) {
+    vec2 local = corner * sprite.size;
+    float cosine = cos(sprite.rotation);
+    float sine = sin(sprite.rotation);
+    return sprite.position - sprite.origin + vec2(local.x * cosine - local.y * sine, local.x * sine + local.y * cosine);
+}
\ No newline at end of file
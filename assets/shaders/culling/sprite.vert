@@ -0,0 +1,21 @@
+#version 460 core
+#include "sprite.glsl"
+
+layout (std430, binding = 5) readonly buffer VisibleSprites {
+    uint visibleSprites[];
+};
+
+out vec2 TexCoord;
+out vec4 VertexColor;
+
+#include "../include/camera.glsl"
+
+void main() {
+    GpuSprite sprite = sprites[visibleSprites[gl_InstanceID]];
+    vec2 corner = corners[gl_VertexID];
+
+    gl_Position = toClipSpace(vec3(spriteCorner(sprite, corner), sprite.depth));
+    // Texture coordinates of the default quad are upside down
+    TexCoord = vec2(mix(sprite.uv.x, sprite.uv.z, corner.x), mix(sprite.uv.w, sprite.uv.y, corner.y));
+    VertexColor = sprite.color;
+}
\ No newline at end of file
@@ -0,0 +1,6 @@
+uniform mat4 view;
+uniform mat4 projection;
+
+vec4 toClipSpace(vec3 position) {
+    return projection * view * vec4(position, 1.0);
+}
@@ -0,0 +1,12 @@
+#version 460 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+uniform sampler2D scene;
+uniform sampler2D lightMap;
+
+void main() {
+    vec4 sceneColor = texture(scene, TexCoord);
+    FragColor = vec4(sceneColor.rgb * texture(lightMap, TexCoord).rgb, sceneColor.a);
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#version 460 core
+out vec4 FragColor;
+
+flat in uint TileIndex;
+
+struct PointLight {
+    vec2 position;
+    float radius;
+    float intensity;
+    vec4 color;
+};
+
+layout (std430, binding = 0) readonly buffer Lights {
+    PointLight lights[];
+};
+
+layout (std430, binding = 1) readonly buffer TileRanges {
+    uvec2 tileRanges[];
+};
+
+layout (std430, binding = 3) readonly buffer LightIndices {
+    uint lightIndices[];
+};
+
+uniform vec4 ambient;
+
+void main() {
+    uvec2 range = tileRanges[TileIndex];
+    vec3 light = ambient.rgb;
+
+    for (uint i = range.x; i < range.x + range.y; i++) {
+        PointLight pointLight = lights[lightIndices[i]];
+        float distance = length(gl_FragCoord.xy - pointLight.position);
+        float falloff = clamp(1.0 - distance / pointLight.radius, 0.0, 1.0);
+        light += pointLight.color.rgb * pointLight.intensity * falloff * falloff;
+    }
+
+    FragColor = vec4(light, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,24 @@
+#version 460 core
+layout (std430, binding = 2) readonly buffer ActiveTiles {
+    uint activeTiles[];
+};
+
+uniform int tilesX;
+uniform int tileSize;
+uniform vec2 screenSize;
+
+flat out uint TileIndex;
+
+const vec2 corners[6] = vec2[](
+    vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(0.0, 1.0),
+    vec2(1.0, 0.0), vec2(1.0, 1.0), vec2(0.0, 1.0)
+);
+
+void main() {
+    uint tile = activeTiles[gl_InstanceID];
+    vec2 tilePos = vec2(tile % uint(tilesX), tile / uint(tilesX)) * float(tileSize);
+    vec2 pixelPos = min(tilePos + corners[gl_VertexID] * float(tileSize), screenSize);
+
+    gl_Position = vec4(pixelPos / screenSize * 2.0 - 1.0, 0.0, 1.0);
+    TileIndex = tile;
+}
\ No newline at end of file
@@ -0,0 +1,18 @@
+#version 460 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+uniform usampler2D overdraw;
+uniform float heatScale;
+
+void main() {
+    float heat = clamp(float(texture(overdraw, TexCoord).r) / heatScale, 0.0, 1.0);
+
+    // Black for untouched pixels, then blue, green, yellow and red as the count grows
+    vec3 color = heat <= 0.0 ? vec3(0.0)
+        : heat < 0.33 ? mix(vec3(0.0, 0.0, 1.0), vec3(0.0, 1.0, 0.0), heat / 0.33)
+        : heat < 0.66 ? mix(vec3(0.0, 1.0, 0.0), vec3(1.0, 1.0, 0.0), (heat - 0.33) / 0.33)
+        : mix(vec3(1.0, 1.0, 0.0), vec3(1.0, 0.0, 0.0), (heat - 0.66) / 0.34);
+    FragColor = vec4(color, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,209 @@
+#include "capture.hpp"
+#include "core.hpp"
+#include <cstring>
+
+void FrameCapture::initialize(std::function<void(CapturedFrame&)> handler)
+{
+    if (initialized) clean();
+
+    this->handler = handler;
+    stopping = false;
+    initialized = true;
+
+    worker = std::thread(&FrameCapture::workerLoop, this);
+}
+
+void FrameCapture::capture(unsigned int framebuffer, int width, int height)
+{
+    if (!initialized) return;
+
+    // Buffers are made on first use, so the object can be set up before there is a context
+    if (!buffersCreated) {
+        for (Slot& slot : slots) {
+            glGenBuffers(1, &slot.PBO);
+        }
+        buffersCreated = true;
+    }
+
+    // The ring is full when the oldest readback still isn't done, skipping is better than waiting
+    Slot& slot = slots[writeIndex];
+    if (slot.pending) update();
+    if (slot.pending) {
+        droppedCount++;
+        return;
+    }
+
+    ObjectDrawer::flush();
+
+    int previousFramebuffer = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousFramebuffer);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+
+    size_t size = (size_t)width * height * 4;
+    if (size > slot.capacity) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+        slot.capacity = size;
+    }
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, previousFramebuffer);
+
+    slot.width = width;
+    slot.height = height;
+    slot.index = captureCount++;
+    slot.pending = true;
+
+    writeIndex = (writeIndex + 1) % FRAME_CAPTURE_RING_SIZE;
+}
+
+void FrameCapture::captureScreen()
+{
+    capture(0, Engine::getScreenWidth(), Engine::getScreenHeight());
+}
+
+void FrameCapture::update()
+{
+    if (!initialized || !buffersCreated) return;
+
+    // Slots are finished in the order they were written, starting with the oldest
+    for (int i = 0; i < FRAME_CAPTURE_RING_SIZE; i++) {
+        Slot& slot = slots[(writeIndex + i) % FRAME_CAPTURE_RING_SIZE];
+        if (!slot.pending) continue;
+
+        GLenum status = glClientWaitSync(slot.fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+        slot.pending = false;
+
+        CapturedFrame frame;
+        frame.index = slot.index;
+        frame.width = slot.width;
+        frame.height = slot.height;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!freeBuffers.empty()) {
+                frame.pixels = std::move(freeBuffers.back());
+                freeBuffers.pop_back();
+            }
+        }
+
+        size_t size = (size_t)slot.width * slot.height * 4;
+        frame.pixels.resize(size);
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+        void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+        if (data) {
+            std::memcpy(frame.pixels.data(), data, size);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        if (data) enqueue(std::move(frame));
+    }
+}
+
+void FrameCapture::enqueue(CapturedFrame&& frame)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        // A slow handler shouldn't make memory grow forever
+        if (queue.size() >= FRAME_CAPTURE_MAX_QUEUED) {
+            freeBuffers.push_back(std::move(queue.front().pixels));
+            queue.pop_front();
+            droppedCount++;
+        }
+
+        queue.push_back(std::move(frame));
+    }
+    condition.notify_one();
+}
+
+void FrameCapture::workerLoop()
+{
+    while (true) {
+        CapturedFrame frame;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [&] { return stopping || !queue.empty(); });
+            if (queue.empty()) return;
+
+            frame = std::move(queue.front());
+            queue.pop_front();
+        }
+
+        if (handler) handler(frame);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        freeBuffers.push_back(std::move(frame.pixels));
+    }
+}
+
+void FrameCapture::stopWorker()
+{
+    if (!worker.joinable()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    worker.join();
+}
+
+void FrameCapture::clean()
+{
+    if (!initialized) return;
+
+    stopWorker();
+
+    if (buffersCreated) {
+        for (Slot& slot : slots) {
+            if (slot.fence) glDeleteSync(slot.fence);
+            glDeleteBuffers(1, &slot.PBO);
+            slot = Slot{};
+        }
+        buffersCreated = false;
+    }
+
+    queue.clear();
+    writeIndex = 0;
+    initialized = false;
+}
+
+bool FrameCapture::saveTGA(const CapturedFrame &frame, const std::string &path)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) return false;
+
+    // Uncompressed true color, 32 bits, rows stored from the bottom like GL
+    unsigned char header[18] = {};
+    header[2] = 2;
+    header[12] = frame.width & 0xFF;
+    header[13] = (frame.width >> 8) & 0xFF;
+    header[14] = frame.height & 0xFF;
+    header[15] = (frame.height >> 8) & 0xFF;
+    header[16] = 32;
+    header[17] = 8;
+    file.write((const char*)header, sizeof(header));
+
+    std::vector<unsigned char> bgra(frame.pixels.size());
+    for (size_t i = 0; i < frame.pixels.size(); i += 4) {
+        bgra[i] = frame.pixels[i + 2];
+        bgra[i + 1] = frame.pixels[i + 1];
+        bgra[i + 2] = frame.pixels[i];
+        bgra[i + 3] = frame.pixels[i + 3];
+    }
+    file.write((const char*)bgra.data(), bgra.size());
+
+    return file.good();
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include "gfx.hpp"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+
+#define FRAME_CAPTURE_RING_SIZE 3
+#define FRAME_CAPTURE_MAX_QUEUED 8
+
+struct CapturedFrame
+{
+    unsigned long long index;
+    int width;
+    int height;
+    // RGBA8 rows, bottom row first as GL stores them
+    std::vector<unsigned char> pixels;
+};
+
+// Reads framebuffers back through a ring of pixel buffer objects. Each readback is mapped a few frames
+// later once its fence has signaled, then handed to a worker thread, so the render thread never waits for the GPU.
+class FrameCapture
+{
+private:
+    struct Slot
+    {
+        unsigned int PBO = 0;
+        GLsync fence = nullptr;
+        size_t capacity = 0;
+        int width = 0;
+        int height = 0;
+        unsigned long long index = 0;
+        bool pending = false;
+    };
+
+    Slot slots[FRAME_CAPTURE_RING_SIZE];
+    int writeIndex = 0;
+    unsigned long long captureCount = 0;
+    unsigned long long droppedCount = 0;
+    bool initialized = false;
+    bool buffersCreated = false;
+
+    std::function<void(CapturedFrame&)> handler;
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<CapturedFrame> queue;
+    std::vector<std::vector<unsigned char>> freeBuffers;
+    bool stopping = false;
+
+    void workerLoop();
+    void enqueue(CapturedFrame&& frame);
+    // Lets the worker finish what is queued and joins it
+    void stopWorker();
+public:
+    FrameCapture() = default;
+    // Only stops the worker, the context may already be gone. GL objects are freed by clean() before Engine::close()
+    ~FrameCapture() { stopWorker(); }
+
+    // Starts the worker, GL objects are created by the first capture. The handler runs on the worker thread,
+    // it's where frames are encoded or written
+    void initialize(std::function<void(CapturedFrame&)> handler);
+
+    inline unsigned long long getCaptureCount() const { return captureCount; }
+    inline unsigned long long getDroppedCount() const { return droppedCount; }
+
+    // Starts an asynchronous readback of the framebuffer
+    void capture(unsigned int framebuffer, int width, int height);
+    void captureScreen();
+    // Checks fences of pending readbacks, call once per frame
+    void update();
+    void clean();
+
+    static bool saveTGA(const CapturedFrame& frame, const std::string& path);
+};
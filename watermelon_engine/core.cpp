@@ -1,4 +1,5 @@
 #include "core.hpp"
+#include "utils.hpp"
 
 std::string Engine::windowTitle;
 int Engine::screenWidth = 800;
@@ -11,8 +12,20 @@ Uint64 Engine::currentTime = 0;
 Uint64 Engine::lastTime = 0;
 double Engine::deltaTime = 0;
 double Engine::smoothedDeltaTime = .016f;
+Uint64 Engine::frameCount = 0;
+
+FramePacingMode Engine::framePacing = FRAME_PACING_VSYNC;
+double Engine::targetFrameRate = 60.0;
+Uint64 Engine::frameStartTime = 0;
+Uint64 Engine::nextFrameDeadline = 0;
+double Engine::frameWorkTime = 0;
+
+double Engine::frameTimes[FRAME_STATS_WINDOW];
+int Engine::frameTimeIndex = 0;
+int Engine::frameTimeCount = 0;
 
 bool Engine::running = false;
+bool Engine::renderThreadActive = false;
 
 void Engine::initialize(std::string title, int width, int height, bool fullscreen)
 {
@@ -74,10 +87,8 @@ void Engine::initialize(std::string title, int width, int height, bool fullscree
     }
     SDL_Log("GL context is now made as current.");
     
-    // Enable VSync
-    if (!SDL_GL_SetSwapInterval(1)) {
-        SDL_Log("Could not enable VSync! Error message: %s", SDL_GetError());
-    }
+    // Enable VSync or whatever pacing was chosen
+    applySwapInterval();
     
     // Load OpenGL functions
     SDL_Log("Loading OpenGL functions...");
@@ -108,8 +119,11 @@ void Engine::update()
     currentTime = SDL_GetPerformanceCounter();
     deltaTime = (double)(currentTime - lastTime) / (double)SDL_GetPerformanceFrequency();
     smoothedDeltaTime = smoothedDeltaTime * (1.f - SMOOTHING) + deltaTime * SMOOTHING;
+    frameCount++;
 
-    ObjectDrawer::bindVertexArray();
+    frameTimes[frameTimeIndex] = deltaTime * 1000.0;
+    frameTimeIndex = (frameTimeIndex + 1) % FRAME_STATS_WINDOW;
+    frameTimeCount = std::min(frameTimeCount + 1, FRAME_STATS_WINDOW);
 }
 
 void Engine::input(SDL_Event &event)
@@ -121,7 +135,7 @@ void Engine::input(SDL_Event &event)
         }
         case SDL_EVENT_WINDOW_RESIZED: {
             setScreenSize(event.window.data1, event.window.data2);
-            glViewport(0, 0, screenWidth, screenHeight);
+            if (!renderThreadActive) glViewport(0, 0, screenWidth, screenHeight);
             break;
         }
     }
@@ -129,6 +143,117 @@ void Engine::input(SDL_Event &event)
     InputHandler::checkGamepadConnections(event);
 }
 
+void Engine::setFramePacing(FramePacingMode mode, double targetFrameRate)
+{
+    framePacing = mode;
+    Engine::targetFrameRate = targetFrameRate;
+    nextFrameDeadline = 0;
+
+    if (window && !renderThreadActive) applySwapInterval();
+}
+
+void Engine::applySwapInterval()
+{
+    switch (framePacing) {
+        case FRAME_PACING_VSYNC: {
+            if (!SDL_GL_SetSwapInterval(1)) {
+                SDL_Log("Could not enable VSync! Error message: %s", SDL_GetError());
+            }
+            break;
+        }
+        case FRAME_PACING_ADAPTIVE_VSYNC: {
+            if (!SDL_GL_SetSwapInterval(-1)) {
+                SDL_Log("Adaptive VSync is not supported, falling back to VSync. Error message: %s", SDL_GetError());
+                SDL_GL_SetSwapInterval(1);
+            }
+            break;
+        }
+        default: {
+            if (!SDL_GL_SetSwapInterval(0)) {
+                SDL_Log("Could not disable VSync! Error message: %s", SDL_GetError());
+            }
+            break;
+        }
+    }
+}
+
+void Engine::sleepUntil(Uint64 counter)
+{
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    Uint64 spinThreshold = (Uint64)(FRAME_SPIN_THRESHOLD * frequency);
+
+    // Sleep is coarse, so it only covers the time until the spin threshold
+    while (true) {
+        Uint64 now = SDL_GetPerformanceCounter();
+        if (now >= counter) break;
+
+        Uint64 remaining = counter - now;
+        if (remaining > spinThreshold) {
+            SDL_DelayNS((remaining - spinThreshold) * SDL_NS_PER_SECOND / frequency);
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void Engine::beginFrame()
+{
+    if (framePacing == FRAME_PACING_LOW_LATENCY && nextFrameDeadline != 0) {
+        // Start sampling input as late as the previous frames' work allows
+        Uint64 workCounter = (Uint64)(frameWorkTime * SDL_GetPerformanceFrequency());
+        if (nextFrameDeadline > workCounter) sleepUntil(nextFrameDeadline - workCounter);
+    }
+
+    frameStartTime = SDL_GetPerformanceCounter();
+}
+
+void Engine::endFrame()
+{
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    Uint64 now = SDL_GetPerformanceCounter();
+
+    double workTime = (double)(now - frameStartTime) / (double)frequency;
+    frameWorkTime = frameWorkTime == 0 ? workTime : frameWorkTime * (1.f - SMOOTHING) + workTime * SMOOTHING;
+
+    if (framePacing != FRAME_PACING_LIMITED && framePacing != FRAME_PACING_LOW_LATENCY) return;
+
+    Uint64 period = (Uint64)(frequency / targetFrameRate);
+    if (nextFrameDeadline == 0) nextFrameDeadline = frameStartTime + period;
+
+    if (framePacing == FRAME_PACING_LIMITED) sleepUntil(nextFrameDeadline);
+
+    // Don't try to catch up after a long frame, just start counting again
+    nextFrameDeadline += period;
+    now = SDL_GetPerformanceCounter();
+    if (now > nextFrameDeadline) nextFrameDeadline = now + period;
+}
+
+FrameTimeStats Engine::getFrameTimeStats()
+{
+    FrameTimeStats stats = { 0, 0, 0, 0, 0 };
+    if (frameTimeCount == 0) return stats;
+
+    stats.min = frameTimes[0];
+    stats.max = frameTimes[0];
+
+    for (int i = 0; i < frameTimeCount; i++) {
+        stats.mean += frameTimes[i];
+        stats.min = std::min(stats.min, frameTimes[i]);
+        stats.max = std::max(stats.max, frameTimes[i]);
+    }
+    stats.mean /= frameTimeCount;
+
+    for (int i = 0; i < frameTimeCount; i++) {
+        double difference = frameTimes[i] - stats.mean;
+        stats.variance += difference * difference;
+    }
+    stats.variance /= frameTimeCount;
+    stats.deviation = std::sqrt(stats.variance);
+
+    return stats;
+}
+
 void Engine::close()
 {
     SDL_Log("Shutting down the engine...");
@@ -142,16 +267,88 @@ void Engine::close()
 void Game::initialize()
 {
     Engine::initialize(title, screenWidth, screenHeight, fullscreen);
+    Engine::setFramePacing(framePacing, targetFrameRate);
     ObjectDrawer::initialize();
 
     globalView = Camera(screenWidth, screenHeight);
 }
 
+FrameQueue::FrameQueue(int capacity)
+{
+    for (int i = 0; i < capacity; i++) {
+        frames.push_back(std::make_unique<FrameSnapshot>());
+        freeFrames.push_back(frames.back().get());
+    }
+}
+
+FrameSnapshot *FrameQueue::acquire()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [&] { return closed || !freeFrames.empty(); });
+    if (closed) return nullptr;
+
+    FrameSnapshot* frame = freeFrames.front();
+    freeFrames.pop_front();
+    return frame;
+}
+
+void FrameQueue::submit(FrameSnapshot *frame)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        readyFrames.push_back(frame);
+    }
+    condition.notify_all();
+}
+
+FrameSnapshot *FrameQueue::take()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [&] { return closed || !readyFrames.empty(); });
+    if (readyFrames.empty()) return nullptr;
+
+    FrameSnapshot* frame = readyFrames.front();
+    readyFrames.pop_front();
+    return frame;
+}
+
+void FrameQueue::release(FrameSnapshot *frame)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        freeFrames.push_back(frame);
+    }
+    condition.notify_all();
+}
+
+void FrameQueue::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+    }
+    condition.notify_all();
+}
+
+void FrameQueue::reopen()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    closed = false;
+}
+
 void Game::run()
 {
     initialize();
 
+    if (renderThreadEnabled) {
+        runThreaded();
+        quit();
+        return;
+    }
+
     while (Engine::running) {
+        Engine::beginFrame();
+
         SDL_Event event;
         while (SDL_PollEvent(&event)) {
             Engine::input(event);
@@ -159,6 +356,11 @@ void Game::run()
         }
 
         Engine::update();
+        RenderStatistics::beginFrame(Engine::getFrameCount());
+        DrawStreamRecorder::beginFrame();
+        AssetManager::updateTextures(Engine::getFrameCount());
+        ObjectDrawer::bindVertexArray();
+        ObjectDrawer::resetState();
         
         globalView.setWidth(Engine::getScreenWidth());
         globalView.setHeight(Engine::getScreenHeight());
@@ -167,15 +369,108 @@ void Game::run()
 
         update((float)Engine::getDeltaTime());
         
+        GpuProfiler::beginPass("frame");
         draw();
+        DEBUG_DRAW_FLUSH(getWorldCamera());
+        GpuProfiler::endPass();
+        ObjectDrawer::flush(FLUSH_REASON_FRAME);
         SDL_GL_SwapWindow(Engine::getWindow());
+
+        Engine::endFrame();
     }
 
     quit();
 }
 
+void Game::runThreaded()
+{
+    // Hand the GL context over to the render thread
+    SDL_GL_MakeCurrent(Engine::getWindow(), nullptr);
+    Engine::renderThreadActive = true;
+    frameQueue.reopen();
+
+    std::thread renderThread(&Game::renderLoop, this);
+
+    while (Engine::running) {
+        Engine::beginFrame();
+
+        SDL_Event event;
+        while (SDL_PollEvent(&event)) {
+            Engine::input(event);
+            input(event);
+        }
+
+        Engine::update();
+
+        globalView.setWidth(Engine::getScreenWidth());
+        globalView.setHeight(Engine::getScreenHeight());
+
+        physicsUpdate((float)Engine::getDeltaTime());
+
+        update((float)Engine::getDeltaTime());
+
+        // Waits only when the render thread is a whole frame behind
+        FrameSnapshot* frame = frameQueue.acquire();
+        if (!frame) break;
+
+        frame->frame = Engine::getFrameCount();
+        frame->clearColor = Color{ 0.f, 0.f, 0.f };
+        frame->screenWidth = Engine::getScreenWidth();
+        frame->screenHeight = Engine::getScreenHeight();
+        frame->drawList.clear();
+        frame->cameras.clear();
+
+        record(*frame);
+        frame->debugCamera = getWorldCamera();
+        frameQueue.submit(frame);
+
+        Engine::endFrame();
+    }
+
+    frameQueue.close();
+    renderThread.join();
+
+    Engine::renderThreadActive = false;
+    SDL_GL_MakeCurrent(Engine::getWindow(), Engine::getGLContext());
+}
+
+void Game::renderLoop()
+{
+    SDL_GL_MakeCurrent(Engine::getWindow(), Engine::getGLContext());
+    Engine::applySwapInterval();
+
+    while (FrameSnapshot* frame = frameQueue.take()) {
+        glViewport(0, 0, frame->screenWidth, frame->screenHeight);
+        RenderStatistics::beginFrame(frame->frame);
+        DrawStreamRecorder::beginFrame();
+        AssetManager::updateTextures(frame->frame);
+        ObjectDrawer::bindVertexArray();
+        ObjectDrawer::resetState();
+        GpuProfiler::beginPass("frame");
+        ObjectDrawer::clearBackground(frame->clearColor);
+
+        GpuProfiler::beginPass("world");
+        for (Camera& camera : frame->cameras) {
+            frame->drawList.replay(camera);
+        }
+        GpuProfiler::endPass();
+
+        DEBUG_DRAW_FLUSH(frame->debugCamera);
+
+        GpuProfiler::endPass();
+        ObjectDrawer::flush(FLUSH_REASON_FRAME);
+        SDL_GL_SwapWindow(Engine::getWindow());
+
+        frameQueue.release(frame);
+    }
+
+    SDL_GL_MakeCurrent(Engine::getWindow(), nullptr);
+}
+
 void Game::quit()
 {
+    DrawStreamRecorder::clean();
+    GpuProfiler::clean();
     ObjectDrawer::clean();
     Engine::close();
 }
@@ -4,10 +4,41 @@
 #include <SDL3/SDL_opengl.h>
 #include <string>
 #include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "input.hpp"
 #include "gfx.hpp"
+#include "draw_list.hpp"
+#include "gpu_timer.hpp"
+#include "debug_draw.hpp"
+#include "draw_stream.hpp"
 
 #define SMOOTHING .15f
+#define FRAME_STATS_WINDOW 120
+// Seconds before a deadline where the limiter stops sleeping and spins
+#define FRAME_SPIN_THRESHOLD .002
+
+enum FramePacingMode {
+    FRAME_PACING_VSYNC,
+    FRAME_PACING_ADAPTIVE_VSYNC,
+    // Hybrid sleep and spin limiter to the target frame rate, vsync off
+    FRAME_PACING_LIMITED,
+    // Input and simulation wait until just before the frame deadline, vsync off
+    FRAME_PACING_LOW_LATENCY,
+    FRAME_PACING_UNCAPPED
+};
+
+struct FrameTimeStats
+{
+    // All in milliseconds over the last FRAME_STATS_WINDOW frames
+    double mean;
+    double variance;
+    double deviation;
+    double min;
+    double max;
+};
 
 class Engine
 {
@@ -23,8 +54,23 @@ private:
     static Uint64 lastTime;
     static double deltaTime;
     static double smoothedDeltaTime;
+    static Uint64 frameCount;
+
+    static FramePacingMode framePacing;
+    static double targetFrameRate;
+    static Uint64 frameStartTime;
+    static Uint64 nextFrameDeadline;
+    static double frameWorkTime;
+
+    static double frameTimes[FRAME_STATS_WINDOW];
+    static int frameTimeIndex;
+    static int frameTimeCount;
+
+    static void sleepUntil(Uint64 counter);
 public:
     static bool running;
+    // GL context belongs to the render thread, the game thread must not touch it
+    static bool renderThreadActive;
 
     static void initialize(std::string title, int width, int height, bool fullscreen);
     static void update();
@@ -43,10 +89,66 @@ public:
     }
 
     static SDL_Window* getWindow() { return window; }
+    static SDL_GLContext getGLContext() { return glContext; }
 
     static float getTime() { return SDL_GetTicks() / 1000.f; }
     static double getDeltaTime() { return deltaTime; }
     static double getSmoothedDelta() { return smoothedDeltaTime; }
+    static Uint64 getFrameCount() { return frameCount; }
+
+    // Swap interval is set on the calling thread's context, the render thread applies it itself
+    static void setFramePacing(FramePacingMode mode, double targetFrameRate = 60.0);
+    static FramePacingMode getFramePacing() { return framePacing; }
+    static double getTargetFrameRate() { return targetFrameRate; }
+    static void applySwapInterval();
+
+    // Called around every frame, before input is polled and after the window is swapped
+    static void beginFrame();
+    static void endFrame();
+
+    static FrameTimeStats getFrameTimeStats();
+};
+
+
+// Everything the render thread needs to draw a frame, the game thread doesn't touch it until it's released
+struct FrameSnapshot
+{
+    unsigned long long frame = 0;
+    Color clearColor = Color{ 0.f, 0.f, 0.f };
+    int screenWidth = 0;
+    int screenHeight = 0;
+
+    DrawList drawList;
+    std::vector<Camera> cameras;
+    // Copied from Game::getWorldCamera() after record()
+    Camera debugCamera;
+};
+
+
+// Bounded handoff between the game and render threads, snapshots are recycled instead of reallocated
+class FrameQueue
+{
+private:
+    std::vector<std::unique_ptr<FrameSnapshot>> frames;
+    std::deque<FrameSnapshot*> freeFrames;
+    std::deque<FrameSnapshot*> readyFrames;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool closed = false;
+public:
+    FrameQueue(int capacity = 2);
+
+    // Game thread side, blocks while all snapshots are in flight
+    FrameSnapshot* acquire();
+    void submit(FrameSnapshot* frame);
+
+    // Render thread side, returns nullptr once the queue is closed and drained
+    FrameSnapshot* take();
+    void release(FrameSnapshot* frame);
+
+    void close();
+    void reopen();
 };
 
 
@@ -58,8 +160,18 @@ protected:
     int screenWidth = 800;
     int screenHeight = 600;
     bool fullscreen = false;
+    FramePacingMode framePacing = FRAME_PACING_VSYNC;
+    double targetFrameRate = 60.0;
+    // When enabled, draw() is not called. record() fills a snapshot that a render thread draws one frame later,
+    // so GL resources (textures, shaders, targets) have to be created in initialize()
+    bool renderThreadEnabled = false;
 
     Camera globalView;
+private:
+    FrameQueue frameQueue;
+
+    void runThreaded();
+    void renderLoop();
 public:
     Game() {}
 
@@ -71,4 +183,7 @@ public:
     virtual void physicsUpdate(float fixedDelta) {};
     virtual void update(float delta) {}
     virtual void draw() {};
+    virtual void record(FrameSnapshot& frame) {};
+    // World space debug shapes (colliders, rays) are drawn with it, return the scrolling game camera
+    virtual Camera& getWorldCamera() { return globalView; }
 };
@@ -0,0 +1,158 @@
+#include "debug_draw.hpp"
+#include <cmath>
+#include <numbers>
+
+std::vector<DebugLine> DebugDraw::lines;
+std::vector<DebugText> DebugDraw::texts;
+std::mutex DebugDraw::mutex;
+std::atomic<bool> DebugDraw::enabled = true;
+
+std::vector<DebugLine> DebugDraw::flushLines;
+std::vector<DebugText> DebugDraw::flushTexts;
+std::vector<BatchVertex> DebugDraw::vertices;
+std::vector<unsigned int> DebugDraw::indices;
+
+void DebugDraw::line(glm::vec2 from, glm::vec2 to, Color color, float thickness)
+{
+    if (!enabled) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    lines.push_back(DebugLine{ from, to, color, thickness });
+}
+
+void DebugDraw::box(Rectangle rectangle, Color color, float thickness)
+{
+    if (!enabled) return;
+
+    glm::vec2 topLeft = glm::vec2{ rectangle.getLeft(), rectangle.getTop() };
+    glm::vec2 topRight = glm::vec2{ rectangle.getRight(), rectangle.getTop() };
+    glm::vec2 bottomRight = glm::vec2{ rectangle.getRight(), rectangle.getBottom() };
+    glm::vec2 bottomLeft = glm::vec2{ rectangle.getLeft(), rectangle.getBottom() };
+
+    std::lock_guard<std::mutex> lock(mutex);
+    lines.push_back(DebugLine{ topLeft, topRight, color, thickness });
+    lines.push_back(DebugLine{ topRight, bottomRight, color, thickness });
+    lines.push_back(DebugLine{ bottomRight, bottomLeft, color, thickness });
+    lines.push_back(DebugLine{ bottomLeft, topLeft, color, thickness });
+}
+
+void DebugDraw::circle(glm::vec2 center, float radius, Color color, float thickness)
+{
+    if (!enabled) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    glm::vec2 previous = center + glm::vec2{ radius, 0.f };
+    for (int i = 1; i <= DEBUG_DRAW_CIRCLE_SEGMENTS; i++) {
+        float angle = 2.f * std::numbers::pi_v<float> * i / DEBUG_DRAW_CIRCLE_SEGMENTS;
+        glm::vec2 next = center + glm::vec2{ std::cos(angle), std::sin(angle) } * radius;
+        lines.push_back(DebugLine{ previous, next, color, thickness });
+        previous = next;
+    }
+}
+
+void DebugDraw::ray(glm::vec2 origin, glm::vec2 direction, float length, Color color, float thickness)
+{
+    if (!enabled || direction == glm::vec2{ 0 }) return;
+
+    line(origin, origin + glm::normalize(direction) * length, color, thickness);
+}
+
+void DebugDraw::text(glm::vec2 position, const std::string &text, Color color, float scale)
+{
+    if (!enabled) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    texts.push_back(DebugText{ position, text, color, scale });
+}
+
+void DebugDraw::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    lines.clear();
+    texts.clear();
+}
+
+void DebugDraw::addQuad(glm::vec2 a, glm::vec2 b, glm::vec2 c, glm::vec2 d, const glm::vec4 &color)
+{
+    unsigned int first = vertices.size();
+    vertices.push_back(BatchVertex{ glm::vec3{ a, 0.f }, glm::vec2{ .5f }, color });
+    vertices.push_back(BatchVertex{ glm::vec3{ b, 0.f }, glm::vec2{ .5f }, color });
+    vertices.push_back(BatchVertex{ glm::vec3{ c, 0.f }, glm::vec2{ .5f }, color });
+    vertices.push_back(BatchVertex{ glm::vec3{ d, 0.f }, glm::vec2{ .5f }, color });
+
+    unsigned int quad[6] = { first, first + 1, first + 3, first + 1, first + 2, first + 3 };
+    indices.insert(indices.end(), quad, quad + 6);
+}
+
+void DebugDraw::addText(Camera &camera, const DebugText &text, float pixelSize)
+{
+    glm::vec4 color = Color{ text.color }.toVec4();
+    glm::vec2 cursor = text.position;
+
+    for (char character : text.text) {
+        if (character == '\n') {
+            cursor = glm::vec2{ text.position.x, cursor.y + (PIXEL_FONT_GLYPH_HEIGHT + 1) * pixelSize };
+            continue;
+        }
+
+        unsigned short glyph = PixelFont::getGlyph(character);
+        for (int row = 0; row < PIXEL_FONT_GLYPH_HEIGHT; row++) {
+            for (int column = 0; column < PIXEL_FONT_GLYPH_WIDTH; column++) {
+                if (!PixelFont::isPixelSet(glyph, column, row)) continue;
+                // Checked per pixel, a long string alone can outgrow a batch
+                if (vertices.size() + 4 > BATCH_MAX_VERTICES) submit(camera);
+
+                glm::vec2 topLeft = cursor + glm::vec2{ (float)column, (float)row } * pixelSize;
+                addQuad(topLeft, topLeft + glm::vec2{ pixelSize, 0.f }, topLeft + glm::vec2{ pixelSize }, topLeft + glm::vec2{ 0.f, pixelSize }, color);
+            }
+        }
+
+        cursor.x += (PIXEL_FONT_GLYPH_WIDTH + 1) * pixelSize;
+    }
+}
+
+void DebugDraw::flush(Camera &camera)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        flushLines.swap(lines);
+        flushTexts.swap(texts);
+    }
+    if (flushLines.empty() && flushTexts.empty()) return;
+
+    // One screen pixel in world units
+    float pixel = 1.f / camera.getZoom();
+
+    for (const DebugLine& line : flushLines) {
+        glm::vec2 direction = line.to - line.from;
+        if (direction == glm::vec2{ 0 }) continue;
+
+        if (vertices.size() + 4 > BATCH_MAX_VERTICES) submit(camera);
+        glm::vec2 side = glm::normalize(glm::vec2{ -direction.y, direction.x }) * line.thickness * pixel / 2.f;
+        addQuad(line.from + side, line.to + side, line.to - side, line.from - side, Color{ line.color }.toVec4());
+    }
+
+    for (const DebugText& text : flushTexts) {
+        addText(camera, text, text.scale * pixel);
+    }
+
+    submit(camera);
+
+    flushLines.clear();
+    flushTexts.clear();
+}
+
+void DebugDraw::submit(Camera &camera)
+{
+    if (vertices.empty()) return;
+
+    // Shapes go over everything drawn so far
+    ObjectDrawer::flush(FLUSH_REASON_STATE);
+    glDisable(GL_DEPTH_TEST);
+    ObjectDrawer::submitBatch(camera, ObjectDrawer::getWhiteTexture(), vertices.data(), vertices.size(), indices.data(), indices.size());
+    ObjectDrawer::flush(FLUSH_REASON_STATE);
+    glEnable(GL_DEPTH_TEST);
+
+    vertices.clear();
+    indices.clear();
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "gfx.hpp"
+#include <mutex>
+#include <atomic>
+
+#define DEBUG_DRAW_CIRCLE_SEGMENTS 24
+
+struct DebugLine
+{
+    glm::vec2 from;
+    glm::vec2 to;
+    Color color;
+    float thickness;
+};
+
+struct DebugText
+{
+    glm::vec2 position;
+    std::string text;
+    Color color;
+    float scale;
+};
+
+// Collects debug shapes from any thread, e.g. colliders from physics code, without touching GL.
+// Everything recorded is drawn on top of the frame in one batched pass by flush() and then forgotten.
+// Text uses PixelFont. Thickness and text size are in screen pixels, so they stay readable at any zoom.
+// Use the DEBUG_DRAW_* macros, they compile to nothing without WATERMELON_DEBUG_DRAW.
+class DebugDraw
+{
+private:
+    static std::vector<DebugLine> lines;
+    static std::vector<DebugText> texts;
+    static std::mutex mutex;
+    static std::atomic<bool> enabled;
+
+    // Reused between flushes
+    static std::vector<DebugLine> flushLines;
+    static std::vector<DebugText> flushTexts;
+    static std::vector<BatchVertex> vertices;
+    static std::vector<unsigned int> indices;
+
+    static void addQuad(glm::vec2 a, glm::vec2 b, glm::vec2 c, glm::vec2 d, const glm::vec4& color);
+    static void addText(Camera& camera, const DebugText& text, float pixelSize);
+    static void submit(Camera& camera);
+public:
+    static bool isEnabled() { return enabled; }
+    static void setEnabled(bool enabled) { DebugDraw::enabled = enabled; }
+
+    static void line(glm::vec2 from, glm::vec2 to, Color color, float thickness = 1.f);
+    static void box(Rectangle rectangle, Color color, float thickness = 1.f);
+    static void circle(glm::vec2 center, float radius, Color color, float thickness = 1.f);
+    static void ray(glm::vec2 origin, glm::vec2 direction, float length, Color color, float thickness = 1.f);
+    // Digits, latin letters (shown uppercase) and basic punctuation
+    static void text(glm::vec2 position, const std::string& text, Color color, float scale = 2.f);
+
+    static void flush(Camera& camera);
+    static void clear();
+};
+
+#ifdef WATERMELON_DEBUG_DRAW
+#define DEBUG_DRAW_LINE(...) DebugDraw::line(__VA_ARGS__)
+#define DEBUG_DRAW_BOX(...) DebugDraw::box(__VA_ARGS__)
+#define DEBUG_DRAW_CIRCLE(...) DebugDraw::circle(__VA_ARGS__)
+#define DEBUG_DRAW_RAY(...) DebugDraw::ray(__VA_ARGS__)
+#define DEBUG_DRAW_TEXT(...) DebugDraw::text(__VA_ARGS__)
+#define DEBUG_DRAW_FLUSH(camera) DebugDraw::flush(camera)
+#else
+#define DEBUG_DRAW_LINE(...) ((void)0)
+#define DEBUG_DRAW_BOX(...) ((void)0)
+#define DEBUG_DRAW_CIRCLE(...) ((void)0)
+#define DEBUG_DRAW_RAY(...) ((void)0)
+#define DEBUG_DRAW_TEXT(...) ((void)0)
+#define DEBUG_DRAW_FLUSH(camera) ((void)0)
+#endif
@@ -0,0 +1,208 @@
+#include "draw_list.hpp"
+#include "world.hpp"
+#include "material.hpp"
+#include <algorithm>
+#include <cstring>
+
+static const unsigned int quadIndices[6] = { 0, 1, 3, 1, 2, 3 };
+
+void DrawList::append(const DrawList &other)
+{
+    commands.insert(commands.end(), other.commands.begin(), other.commands.end());
+}
+
+void DrawList::addTexture(Texture &texture, glm::vec2 position, glm::vec2 origin, glm::vec2 scale, float rotation, glm::vec2 sourceSize, const UVRect &uv, bool flipH, bool flipV, Shader *shader, float depth)
+{
+    DrawCommand command;
+    command.texture = texture;
+    command.shader = shader;
+    command.material = material;
+    command.sortKey = makeSortKey(depth, material ? material->getId() : 0, texture.getId());
+    command.uv = uv;
+    command.depth = depth;
+
+    command.position = position;
+    command.origin = origin;
+    command.scale = scale;
+    command.rotation = rotation;
+    command.sourceSize = sourceSize;
+
+    if (flipH) std::swap(command.uv.uv0.x, command.uv.uv1.x);
+    if (flipV) std::swap(command.uv.uv0.y, command.uv.uv1.y);
+
+    // Same transformation as the model matrix of ObjectDrawer::drawTexture
+    float angle = glm::radians(rotation);
+    float cosine = std::cos(angle);
+    float sine = std::sin(angle);
+    glm::vec2 size = sourceSize * scale;
+    glm::vec2 translation = position - origin;
+
+    glm::vec2 localCorners[4] = { { 0.f, 0.f }, { size.x, 0.f }, { size.x, size.y }, { 0.f, size.y } };
+    glm::vec2 min = glm::vec2{ std::numeric_limits<float>::max() };
+    glm::vec2 max = glm::vec2{ std::numeric_limits<float>::lowest() };
+
+    for (int i = 0; i < 4; i++) {
+        glm::vec2 local = localCorners[i];
+        command.corners[i] = translation + glm::vec2{ local.x * cosine - local.y * sine, local.x * sine + local.y * cosine };
+        min = glm::min(min, command.corners[i]);
+        max = glm::max(max, command.corners[i]);
+    }
+
+    command.bounds = Rectangle{ min.x, min.y, max.x - min.x, max.y - min.y };
+
+    commands.push_back(command);
+}
+
+void DrawList::addTexture(Texture &texture, glm::vec2 position, glm::vec2 origin, glm::vec2 scale, float rotation, Rectangle *source, bool flipH, bool flipV, Shader *shader, float depth)
+{
+    if (source != nullptr) {
+        glm::vec2 sourceSize = glm::vec2{ source->width, source->height };
+        addTexture(texture, position, origin, scale, rotation, sourceSize, UVRect{ *source, texture.getWidth(), texture.getHeight() }, flipH, flipV, shader, depth);
+    }
+    else {
+        glm::vec2 sourceSize = glm::vec2{ texture.getWidth(), texture.getHeight() };
+        addTexture(texture, position, origin, scale, rotation, sourceSize, UVRect{}, flipH, flipV, shader, depth);
+    }
+}
+
+unsigned long long DrawList::makeSortKey(float depth, unsigned short materialId, unsigned int textureId)
+{
+    // Sortable float bits, the top 24 are enough to keep depth layers apart
+    unsigned int bits;
+    std::memcpy(&bits, &depth, sizeof(bits));
+    bits = (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+
+    return ((unsigned long long)(bits >> 8) << 40) | ((unsigned long long)materialId << 24) | (textureId & 0xFFFFFFu);
+}
+
+void DrawList::sort()
+{
+    std::stable_sort(commands.begin(), commands.end(), [](const DrawCommand& a, const DrawCommand& b) {
+        return a.sortKey < b.sortKey;
+    });
+}
+
+void DrawList::replay(Camera &camera)
+{
+    Rectangle visibleBounds = camera.getVisibleBounds();
+    ObjectDrawer::setBatchCamera(camera);
+
+    for (DrawCommand& command : commands) {
+        if (!visibleBounds.intersects(command.bounds)) {
+            RenderStatistics::get().culledObjects++;
+            continue;
+        }
+
+        if (command.material) {
+            ObjectDrawer::useMaterial(command.material);
+            ObjectDrawer::drawTexture(camera, command.texture, command.position, command.origin, command.scale, command.rotation, command.sourceSize, command.uv, false, false, command.material->getShader(), command.depth);
+            continue;
+        }
+
+        if (command.shader) {
+            // UVs are already flipped
+            ObjectDrawer::drawTexture(camera, command.texture, command.position, command.origin, command.scale, command.rotation, command.sourceSize, command.uv, false, false, command.shader, command.depth);
+            continue;
+        }
+
+        // Corners follow the default quad, whose texture coordinates are upside down
+        const UVRect& uv = command.uv;
+        glm::vec4 white = glm::vec4{ 1.f, 1.f, 1.f, 1.f };
+        BatchVertex vertices[4] = {
+            { glm::vec3{ command.corners[0], command.depth }, glm::vec2{ uv.uv0.x, uv.uv1.y }, white },
+            { glm::vec3{ command.corners[1], command.depth }, glm::vec2{ uv.uv1.x, uv.uv1.y }, white },
+            { glm::vec3{ command.corners[2], command.depth }, glm::vec2{ uv.uv1.x, uv.uv0.y }, white },
+            { glm::vec3{ command.corners[3], command.depth }, glm::vec2{ uv.uv0.x, uv.uv0.y }, white }
+        };
+
+        ObjectDrawer::submitBatch(command.texture, vertices, 4, quadIndices, 6);
+    }
+
+    // Drawn now while the caller's viewport and target are still bound, e.g. per split screen camera
+    ObjectDrawer::flush();
+}
+
+ParallelRecorder::ParallelRecorder(int workerCount)
+{
+    for (int i = 0; i < workerCount; i++) {
+        workers.emplace_back(&ParallelRecorder::workerLoop, this);
+    }
+}
+
+void ParallelRecorder::workerLoop()
+{
+    int seenGeneration = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeCondition.wait(lock, [&] { return stopping || generation != seenGeneration; });
+            if (stopping) return;
+            seenGeneration = generation;
+        }
+
+        runJobs();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busyWorkers--;
+            if (busyWorkers == 0) doneCondition.notify_one();
+        }
+    }
+}
+
+void ParallelRecorder::runJobs()
+{
+    for (int i = nextJob++; i < jobCount; i = nextJob++) {
+        (*currentJob)(i, jobLists[i]);
+    }
+}
+
+void ParallelRecorder::record(int jobCount, const std::function<void(int, DrawList&)>& job, DrawList& output)
+{
+    if (jobLists.size() < jobCount) jobLists.resize(jobCount);
+    for (int i = 0; i < jobCount; i++) {
+        jobLists[i].clear();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        currentJob = &job;
+        this->jobCount = jobCount;
+        nextJob = 0;
+        busyWorkers = workers.size();
+        generation++;
+    }
+    wakeCondition.notify_all();
+
+    runJobs();
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        doneCondition.wait(lock, [&] { return busyWorkers == 0; });
+        currentJob = nullptr;
+    }
+
+    for (int i = 0; i < jobCount; i++) {
+        output.append(jobLists[i]);
+    }
+}
+
+void ParallelRecorder::record(std::vector<WorldObject*>& roots, DrawList& output)
+{
+    record(roots.size(), [&](int index, DrawList& list) { roots[index]->record(list); }, output);
+}
+
+void ParallelRecorder::clean()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeCondition.notify_all();
+
+    for (std::thread& worker : workers) {
+        if (worker.joinable()) worker.join();
+    }
+    workers.clear();
+}
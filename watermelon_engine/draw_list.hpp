@@ -0,0 +1,98 @@
+#pragma once
+#include "gfx.hpp"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+class WorldObject;
+
+struct DrawCommand
+{
+    Texture texture;
+    Shader* shader;
+    Material* material;
+    // Depth, material id and texture id packed so sorting groups commands that share state
+    unsigned long long sortKey;
+
+    // Quad corners in world space, computed once when recorded
+    glm::vec2 corners[4];
+    UVRect uv;
+    float depth;
+    Rectangle bounds;
+
+    // Kept for commands with a custom shader, those can't be batched and go through ObjectDrawer::drawTexture
+    glm::vec2 position;
+    glm::vec2 origin;
+    glm::vec2 scale;
+    float rotation;
+    glm::vec2 sourceSize;
+};
+
+class DrawList
+{
+private:
+    std::vector<DrawCommand> commands;
+    // Stamped on added commands until changed
+    Material* material = nullptr;
+public:
+    DrawList() = default;
+
+    static unsigned long long makeSortKey(float depth, unsigned short materialId, unsigned int textureId);
+
+    inline std::vector<DrawCommand>& getCommands() { return commands; }
+    inline int getCommandCount() const { return commands.size(); }
+
+    void clear() { commands.clear(); }
+    void append(const DrawList& other);
+
+    inline Material* getMaterial() { return material; }
+    inline void setMaterial(Material* material) { this->material = material; }
+
+    // Same parameters as ObjectDrawer::drawTexture but without a camera, so one list can be replayed by many cameras
+    void addTexture(Texture& texture, glm::vec2 position, glm::vec2 origin, glm::vec2 scale, float rotation, glm::vec2 sourceSize, const UVRect& uv, bool flipH, bool flipV, Shader* shader, float depth = 0);
+    void addTexture(Texture& texture, glm::vec2 position, glm::vec2 origin, glm::vec2 scale, float rotation, Rectangle* source, bool flipH, bool flipV, Shader* shader, float depth = 0);
+
+    // Orders commands by depth, then material, then texture. Commands of equal depth lose their recorded order,
+    // so only sort lists whose overlapping sprites are told apart by depth
+    void sort();
+
+    // Culls recorded commands against the camera and submits the visible ones in recorded order
+    void replay(Camera& camera);
+};
+
+// Records parts of the scene on worker threads. Each job fills its own list without touching GL,
+// and the lists are merged in job order so the result doesn't depend on thread timing.
+class ParallelRecorder
+{
+private:
+    std::vector<std::thread> workers;
+    std::vector<DrawList> jobLists;
+
+    const std::function<void(int, DrawList&)>* currentJob = nullptr;
+    int jobCount = 0;
+    std::atomic<int> nextJob = 0;
+
+    std::mutex mutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable doneCondition;
+    int generation = 0;
+    int busyWorkers = 0;
+    bool stopping = false;
+
+    void workerLoop();
+    void runJobs();
+public:
+    ParallelRecorder() : ParallelRecorder(std::max(1u, std::thread::hardware_concurrency()) - 1) {}
+    ParallelRecorder(int workerCount);
+    ~ParallelRecorder() { clean(); }
+
+    inline int getWorkerCount() const { return workers.size(); }
+
+    // Runs job(index, list) for every index, the calling thread helps, then appends all lists to output
+    void record(int jobCount, const std::function<void(int, DrawList&)>& job, DrawList& output);
+    // Every root with its children is one job
+    void record(std::vector<WorldObject*>& roots, DrawList& output);
+    void clean();
+};
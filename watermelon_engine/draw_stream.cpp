@@ -0,0 +1,491 @@
+#include "draw_stream.hpp"
+#include "core.hpp"
+#include "utils.hpp"
+#include <fstream>
+
+std::mutex DrawStreamRecorder::requestMutex;
+bool DrawStreamRecorder::startRequested = false;
+bool DrawStreamRecorder::stopRequested = false;
+std::string DrawStreamRecorder::requestedPath;
+int DrawStreamRecorder::requestedFrames = 0;
+
+std::atomic<bool> DrawStreamRecorder::recording = false;
+std::string DrawStreamRecorder::path;
+int DrawStreamRecorder::framesLeft = 0;
+unsigned int DrawStreamRecorder::frameCount = 0;
+std::vector<unsigned char> DrawStreamRecorder::buffer;
+
+std::unordered_map<unsigned int, unsigned short> DrawStreamRecorder::textureIndices;
+std::unordered_map<unsigned int, unsigned short> DrawStreamRecorder::shaderIndices;
+float DrawStreamRecorder::cameraState[8];
+bool DrawStreamRecorder::hasCamera = false;
+
+void DrawStreamRecorder::start(const std::string &path, int frames)
+{
+    std::lock_guard<std::mutex> lock(requestMutex);
+
+    requestedPath = path;
+    requestedFrames = std::max(1, frames);
+    startRequested = true;
+    stopRequested = false;
+}
+
+void DrawStreamRecorder::stop()
+{
+    std::lock_guard<std::mutex> lock(requestMutex);
+
+    startRequested = false;
+    stopRequested = true;
+}
+
+void DrawStreamRecorder::beginFrame()
+{
+    bool starting = false;
+    {
+        std::lock_guard<std::mutex> lock(requestMutex);
+
+        // A new start ends the recording in progress as well
+        if ((startRequested || stopRequested) && recording) finish();
+        if (startRequested) {
+            path = requestedPath;
+            framesLeft = requestedFrames;
+            starting = true;
+        }
+        startRequested = false;
+        stopRequested = false;
+    }
+
+    if (starting) {
+        recording = true;
+        frameCount = 0;
+        buffer.clear();
+        textureIndices.clear();
+        shaderIndices.clear();
+
+        DrawStreamHeader header = { DRAW_STREAM_MAGIC, DRAW_STREAM_VERSION, 0, Engine::getScreenWidth(), Engine::getScreenHeight() };
+        write(header);
+    }
+
+    if (!recording) return;
+    if (framesLeft == 0) {
+        finish();
+        return;
+    }
+
+    framesLeft--;
+    write(DRAW_STREAM_FRAME);
+    write(frameCount++);
+
+    // Every frame starts with its own state so frames can be replayed in any order
+    hasCamera = false;
+    recordVertexFormat(ObjectDrawer::getBatchVertexFormat());
+}
+
+void DrawStreamRecorder::clean()
+{
+    std::lock_guard<std::mutex> lock(requestMutex);
+
+    startRequested = false;
+    stopRequested = false;
+    if (recording) finish();
+}
+
+void DrawStreamRecorder::finish()
+{
+    recording = false;
+
+    // Patch the frame count now that it's known
+    DrawStreamHeader* header = (DrawStreamHeader*)buffer.data();
+    header->frameCount = frameCount;
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        SDL_Log("Could not write draw stream to %s", path.c_str());
+    }
+    else {
+        file.write((const char*)buffer.data(), buffer.size());
+        SDL_Log("Draw stream of %u frames (%zu bytes) written to %s", frameCount, buffer.size(), path.c_str());
+    }
+
+    buffer.clear();
+    buffer.shrink_to_fit();
+    textureIndices.clear();
+    shaderIndices.clear();
+}
+
+void DrawStreamRecorder::writeString(const std::string &text)
+{
+    write((unsigned short)text.size());
+    buffer.insert(buffer.end(), text.begin(), text.end());
+}
+
+unsigned short DrawStreamRecorder::useTexture(Texture &texture)
+{
+    auto found = textureIndices.find(texture.getId());
+    if (found != textureIndices.end()) return found->second;
+
+    unsigned short index = textureIndices.size();
+    textureIndices[texture.getId()] = index;
+
+    std::string key = AssetManager::getTextureKey(texture);
+    DrawStreamTextureSource source = !key.empty() ? DRAW_STREAM_TEXTURE_ASSET
+        : texture == ObjectDrawer::getWhiteTexture() ? DRAW_STREAM_TEXTURE_WHITE
+        : DRAW_STREAM_TEXTURE_OTHER;
+
+    write(DRAW_STREAM_DEFINE_TEXTURE);
+    write(index);
+    write(source);
+    write(texture.getWidth());
+    write(texture.getHeight());
+    writeString(key);
+    return index;
+}
+
+unsigned short DrawStreamRecorder::useShader(Shader *shader)
+{
+    if (!shader) return DRAW_STREAM_NO_SHADER;
+
+    auto found = shaderIndices.find(shader->getId());
+    if (found != shaderIndices.end()) return found->second;
+
+    unsigned short index = shaderIndices.size();
+    shaderIndices[shader->getId()] = index;
+
+    write(DRAW_STREAM_DEFINE_SHADER);
+    write(index);
+    writeString(AssetManager::getShaderKey(*shader));
+    return index;
+}
+
+void DrawStreamRecorder::useCamera(Camera &camera)
+{
+    float state[8] = {
+        camera.getPosition().x, camera.getPosition().y,
+        camera.getOrigin().x, camera.getOrigin().y,
+        camera.getRotation(), camera.getZoom(),
+        camera.getWidth(), camera.getHeight()
+    };
+    if (hasCamera && std::memcmp(state, cameraState, sizeof(state)) == 0) return;
+
+    std::memcpy(cameraState, state, sizeof(state));
+    hasCamera = true;
+
+    write(DRAW_STREAM_CAMERA);
+    write(cameraState);
+}
+
+void DrawStreamRecorder::recordClear(Color color)
+{
+    write(DRAW_STREAM_CLEAR);
+    write(color.toVec4());
+}
+
+void DrawStreamRecorder::recordTexture(Camera &camera, Texture &texture, glm::vec2 position, glm::vec2 origin, glm::vec2 scale, float rotation, glm::vec2 sourceSize, const UVRect &uv, bool flipH, bool flipV, Shader *shader, float depth)
+{
+    unsigned short textureIndex = useTexture(texture);
+    unsigned short shaderIndex = useShader(shader);
+    useCamera(camera);
+
+    write(DRAW_STREAM_TEXTURE);
+    write(textureIndex);
+    write(shaderIndex);
+    write(position);
+    write(origin);
+    write(scale);
+    write(rotation);
+    write(sourceSize);
+    write(uv.uv0);
+    write(uv.uv1);
+    write((unsigned char)(flipH | flipV << 1));
+    write(depth);
+}
+
+void DrawStreamRecorder::recordRectangle(Camera &camera, Rectangle rectangle, Color color, float layerDepth)
+{
+    useCamera(camera);
+
+    write(DRAW_STREAM_RECTANGLE);
+    write(rectangle);
+    write(color.toVec4());
+    write(layerDepth);
+}
+
+void DrawStreamRecorder::recordCircle(Camera &camera, glm::vec2 position, float radius, Color color, float layerDepth)
+{
+    useCamera(camera);
+
+    write(DRAW_STREAM_CIRCLE);
+    write(position);
+    write(radius);
+    write(color.toVec4());
+    write(layerDepth);
+}
+
+void DrawStreamRecorder::recordBatchCamera(Camera &camera)
+{
+    useCamera(camera);
+    write(DRAW_STREAM_BATCH_CAMERA);
+}
+
+void DrawStreamRecorder::recordBatch(Texture &texture, const BatchVertex *vertices, int vertexCount, const unsigned int *indices, int indexCount, glm::vec3 offset)
+{
+    unsigned short textureIndex = useTexture(texture);
+
+    // Counts fit 16 bits since a submission never exceeds the batch size
+    write(DRAW_STREAM_BATCH);
+    write(textureIndex);
+    write(offset);
+    write((unsigned short)vertexCount);
+    write((unsigned short)indexCount);
+
+    const unsigned char* bytes = (const unsigned char*)vertices;
+    buffer.insert(buffer.end(), bytes, bytes + vertexCount * sizeof(BatchVertex));
+    for (int i = 0; i < indexCount; i++) {
+        write((unsigned short)indices[i]);
+    }
+}
+
+void DrawStreamRecorder::recordFlush(FlushReason reason)
+{
+    write(DRAW_STREAM_FLUSH);
+    write((unsigned char)reason);
+}
+
+void DrawStreamRecorder::recordVertexFormat(VertexFormat format)
+{
+    write(DRAW_STREAM_VERTEX_FORMAT);
+    write((unsigned char)format);
+}
+
+
+bool DrawStreamPlayer::readHeader(const std::string &path, DrawStreamHeader &header)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.read((char*)&header, sizeof(header))) {
+        SDL_Log("Could not read draw stream %s", path.c_str());
+        return false;
+    }
+
+    if (header.magic != DRAW_STREAM_MAGIC || header.version != DRAW_STREAM_VERSION) {
+        SDL_Log("%s is not a draw stream of version %d", path.c_str(), DRAW_STREAM_VERSION);
+        return false;
+    }
+    return true;
+}
+
+bool DrawStreamPlayer::load(const std::string &path)
+{
+    clean();
+    if (!readHeader(path, header)) return false;
+
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    data.resize(file.tellg());
+    file.seekg(0);
+    file.read((char*)data.data(), data.size());
+
+    size_t position = sizeof(DrawStreamHeader);
+    while (position < data.size()) {
+        if (data[position] == DRAW_STREAM_FRAME) frameOffsets.push_back(position);
+        if (!step(position, true, false)) {
+            SDL_Log("Draw stream %s is corrupted at byte %zu", path.c_str(), position);
+            return false;
+        }
+    }
+
+    if (frameOffsets.size() != header.frameCount) {
+        SDL_Log("Draw stream %s has %zu of %u frames, it was cut short", path.c_str(), frameOffsets.size(), header.frameCount);
+    }
+    return true;
+}
+
+bool DrawStreamPlayer::readString(size_t &position, std::string &text)
+{
+    unsigned short length;
+    if (!read(position, length) || position + length > data.size()) return false;
+
+    text.assign((const char*)data.data() + position, length);
+    position += length;
+    return true;
+}
+
+bool DrawStreamPlayer::step(size_t &position, bool define, bool run)
+{
+    DrawStreamRecordType type;
+    if (!read(position, type)) return false;
+
+    switch (type) {
+        case DRAW_STREAM_FRAME: {
+            unsigned int frame;
+            return read(position, frame);
+        }
+        case DRAW_STREAM_DEFINE_TEXTURE: {
+            unsigned short index;
+            DrawStreamTextureSource source;
+            float width, height;
+            std::string key;
+            if (!read(position, index) || !read(position, source) || !read(position, width) || !read(position, height) || !readString(position, key)) return false;
+            if (!define) return true;
+
+            if (textures.size() <= index) {
+                textures.resize(index + 1);
+                ownedTextures.resize(index + 1, false);
+            }
+
+            if (source == DRAW_STREAM_TEXTURE_ASSET) {
+                textures[index] = AssetManager::loadTexture(key);
+            }
+            else if (source == DRAW_STREAM_TEXTURE_WHITE) {
+                textures[index] = ObjectDrawer::getWhiteTexture();
+            }
+            else {
+                // Contents don't matter for timing, only the size
+                int pixelCount = std::max(1, (int)width) * std::max(1, (int)height);
+                std::vector<unsigned char> pixels(pixelCount * 4, 255);
+                textures[index] = Texture(pixels.data(), std::max(1.f, width), std::max(1.f, height));
+                ownedTextures[index] = true;
+            }
+            return true;
+        }
+        case DRAW_STREAM_DEFINE_SHADER: {
+            unsigned short index;
+            std::string key;
+            if (!read(position, index) || !readString(position, key)) return false;
+            if (!define) return true;
+
+            if (shaders.size() <= index) shaders.resize(index + 1, nullptr);
+
+            size_t separator = key.find(';');
+            if (key.empty()) {
+                SDL_Log("Draw stream uses a shader that wasn't loaded from files, it's replayed with the default shader");
+            }
+            else if (separator != std::string::npos) {
+                shaders[index] = &AssetManager::loadShader(key.substr(0, separator), key.substr(separator + 1));
+            }
+            else {
+                ShaderLoadType loadType = key.ends_with(".vert") ? SHADER_LOAD_TYPE_VERT : SHADER_LOAD_TYPE_FRAG;
+                shaders[index] = &AssetManager::loadShader(key, loadType);
+            }
+            return true;
+        }
+        case DRAW_STREAM_CAMERA: {
+            float state[8];
+            if (!read(position, state)) return false;
+            if (!run) return true;
+
+            // The position is stored zoomed, set it before the zoom to get the same camera back
+            camera = Camera(state[6], state[7]);
+            camera.setPosition(glm::vec2{ state[0], state[1] });
+            camera.setOrigin(glm::vec2{ state[2], state[3] });
+            camera.setRotation(state[4]);
+            camera.setZoom(state[5]);
+            return true;
+        }
+        case DRAW_STREAM_VERTEX_FORMAT: {
+            unsigned char format;
+            if (!read(position, format) || format >= VERTEX_FORMAT_COUNT) return false;
+            if (run) ObjectDrawer::setBatchVertexFormat((VertexFormat)format);
+            return true;
+        }
+        case DRAW_STREAM_CLEAR: {
+            glm::vec4 color;
+            if (!read(position, color)) return false;
+            if (run) ObjectDrawer::clearBackground(Color{ color.x, color.y, color.z, color.w });
+            return true;
+        }
+        case DRAW_STREAM_TEXTURE: {
+            unsigned short textureIndex, shaderIndex;
+            glm::vec2 drawPosition, origin, scale, sourceSize;
+            UVRect uv;
+            float rotation, depth;
+            unsigned char flips;
+            if (!read(position, textureIndex) || !read(position, shaderIndex) || !read(position, drawPosition) || !read(position, origin)
+                || !read(position, scale) || !read(position, rotation) || !read(position, sourceSize) || !read(position, uv.uv0)
+                || !read(position, uv.uv1) || !read(position, flips) || !read(position, depth)) return false;
+            if (textureIndex >= textures.size()) return false;
+            if (!run) return true;
+
+            Shader* shader = shaderIndex < shaders.size() ? shaders[shaderIndex] : nullptr;
+            ObjectDrawer::drawTexture(camera, textures[textureIndex], drawPosition, origin, scale, rotation, sourceSize, uv, flips & 1, flips & 2, shader, depth);
+            return true;
+        }
+        case DRAW_STREAM_RECTANGLE: {
+            Rectangle rectangle;
+            glm::vec4 color;
+            float depth;
+            if (!read(position, rectangle) || !read(position, color) || !read(position, depth)) return false;
+            if (run) ObjectDrawer::drawRectangle(camera, rectangle, Color{ color.x, color.y, color.z, color.w }, depth);
+            return true;
+        }
+        case DRAW_STREAM_CIRCLE: {
+            glm::vec2 center;
+            float radius, depth;
+            glm::vec4 color;
+            if (!read(position, center) || !read(position, radius) || !read(position, color) || !read(position, depth)) return false;
+            if (run) ObjectDrawer::drawCircle(camera, center, radius, Color{ color.x, color.y, color.z, color.w }, depth);
+            return true;
+        }
+        case DRAW_STREAM_BATCH_CAMERA: {
+            if (run) ObjectDrawer::setBatchCamera(camera);
+            return true;
+        }
+        case DRAW_STREAM_BATCH: {
+            unsigned short textureIndex, vertexCount, indexCount;
+            glm::vec3 offset;
+            if (!read(position, textureIndex) || !read(position, offset) || !read(position, vertexCount) || !read(position, indexCount)) return false;
+
+            size_t size = vertexCount * sizeof(BatchVertex) + indexCount * sizeof(unsigned short);
+            if (textureIndex >= textures.size() || position + size > data.size()) return false;
+            if (!run) {
+                position += size;
+                return true;
+            }
+
+            // Copied out since records aren't aligned
+            vertices.resize(vertexCount);
+            std::memcpy(vertices.data(), data.data() + position, vertexCount * sizeof(BatchVertex));
+            position += vertexCount * sizeof(BatchVertex);
+
+            indices.resize(indexCount);
+            for (int i = 0; i < indexCount; i++) {
+                unsigned short index;
+                read(position, index);
+                indices[i] = index;
+            }
+
+            ObjectDrawer::submitBatch(textures[textureIndex], vertices.data(), vertexCount, indices.data(), indexCount, offset);
+            return true;
+        }
+        case DRAW_STREAM_FLUSH: {
+            unsigned char reason;
+            if (!read(position, reason) || reason >= FLUSH_REASON_COUNT) return false;
+            if (run) ObjectDrawer::flush((FlushReason)reason);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void DrawStreamPlayer::replayFrame(int frame)
+{
+    if (frame < 0 || frame >= frameOffsets.size()) return;
+
+    size_t position = frameOffsets[frame];
+    size_t end = frame + 1 < frameOffsets.size() ? frameOffsets[frame + 1] : data.size();
+    while (position < end) {
+        if (!step(position, false, true)) break;
+    }
+}
+
+void DrawStreamPlayer::clean()
+{
+    for (int i = 0; i < textures.size(); i++) {
+        if (ownedTextures[i]) textures[i].clean();
+    }
+
+    data.clear();
+    frameOffsets.clear();
+    textures.clear();
+    ownedTextures.clear();
+    shaders.clear();
+}
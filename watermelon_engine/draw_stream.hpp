@@ -0,0 +1,147 @@
+#pragma once
+#include "gfx.hpp"
+#include <unordered_map>
+#include <cstring>
+#include <atomic>
+#include <mutex>
+
+// "WMDS" read as a little endian integer
+#define DRAW_STREAM_MAGIC 0x53444D57
+#define DRAW_STREAM_VERSION 1
+// Marks a draw without its own shader, the drawer's default is used
+#define DRAW_STREAM_NO_SHADER 0xFFFF
+
+enum DrawStreamRecordType : unsigned char
+{
+    DRAW_STREAM_FRAME,
+    DRAW_STREAM_DEFINE_TEXTURE,
+    DRAW_STREAM_DEFINE_SHADER,
+    DRAW_STREAM_CAMERA,
+    DRAW_STREAM_VERTEX_FORMAT,
+    DRAW_STREAM_CLEAR,
+    DRAW_STREAM_TEXTURE,
+    DRAW_STREAM_RECTANGLE,
+    DRAW_STREAM_CIRCLE,
+    DRAW_STREAM_BATCH_CAMERA,
+    DRAW_STREAM_BATCH,
+    DRAW_STREAM_FLUSH
+};
+
+enum DrawStreamTextureSource : unsigned char
+{
+    // Loaded through AssetManager, replayed from the same path
+    DRAW_STREAM_TEXTURE_ASSET,
+    DRAW_STREAM_TEXTURE_WHITE,
+    // Render targets and generated textures, replayed as white textures of the same size
+    DRAW_STREAM_TEXTURE_OTHER
+};
+
+struct DrawStreamHeader
+{
+    unsigned int magic;
+    unsigned int version;
+    unsigned int frameCount;
+    int screenWidth;
+    int screenHeight;
+};
+
+// Serializes everything submitted through ObjectDrawer for a number of frames: draws, batches with their
+// vertices, camera changes and flushes. Textures and shaders are written once as definitions the first time
+// they are used, draws refer to them by index. Work done outside of the drawer (lighting, materials, custom GL) isn't recorded.
+// The stream is kept in memory and written when the last frame ends.
+// start() and stop() only leave a request and may be called from the game thread in Game::runThreaded(),
+// it's picked up by beginFrame() on the render thread. Everything else runs on the render thread.
+class DrawStreamRecorder
+{
+private:
+    // Requests from start() and stop(), guarded by requestMutex
+    static std::mutex requestMutex;
+    static bool startRequested;
+    static bool stopRequested;
+    static std::string requestedPath;
+    static int requestedFrames;
+
+    static std::atomic<bool> recording;
+    static std::string path;
+    static int framesLeft;
+    static unsigned int frameCount;
+    static std::vector<unsigned char> buffer;
+
+    static std::unordered_map<unsigned int, unsigned short> textureIndices;
+    static std::unordered_map<unsigned int, unsigned short> shaderIndices;
+    // Position, origin, rotation, zoom, width and height of the camera written last
+    static float cameraState[8];
+    static bool hasCamera;
+
+    template<typename T>
+    static void write(const T& value) {
+        const unsigned char* bytes = (const unsigned char*)&value;
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+    }
+    static void writeString(const std::string& text);
+
+    static unsigned short useTexture(Texture& texture);
+    static unsigned short useShader(Shader* shader);
+    static void useCamera(Camera& camera);
+    static void finish();
+public:
+    // Recording begins with the next frame, so captured frames are always complete
+    static void start(const std::string& path, int frames);
+    // Writes what was captured so far when the next frame begins
+    static void stop();
+    static bool isRecording() { return recording.load(std::memory_order_relaxed); }
+    static void beginFrame();
+    // Writes a recording still in progress, Game::quit() calls it before the context goes away
+    static void clean();
+
+    static void recordClear(Color color);
+    static void recordTexture(Camera& camera, Texture& texture, glm::vec2 position, glm::vec2 origin, glm::vec2 scale, float rotation, glm::vec2 sourceSize, const UVRect& uv, bool flipH, bool flipV, Shader* shader, float depth);
+    static void recordRectangle(Camera& camera, Rectangle rectangle, Color color, float layerDepth);
+    static void recordCircle(Camera& camera, glm::vec2 position, float radius, Color color, float layerDepth);
+    static void recordBatchCamera(Camera& camera);
+    static void recordBatch(Texture& texture, const BatchVertex* vertices, int vertexCount, const unsigned int* indices, int indexCount, glm::vec3 offset);
+    static void recordFlush(FlushReason reason);
+    static void recordVertexFormat(VertexFormat format);
+};
+
+// Loads a recorded stream and submits its frames through ObjectDrawer again. Textures and shaders are
+// resolved on load, so it needs a current GL context and the assets next to the working directory.
+class DrawStreamPlayer
+{
+private:
+    std::vector<unsigned char> data;
+    std::vector<size_t> frameOffsets;
+    DrawStreamHeader header = {};
+
+    std::vector<Texture> textures;
+    std::vector<bool> ownedTextures;
+    std::vector<Shader*> shaders;
+    Camera camera;
+    std::vector<BatchVertex> vertices;
+    std::vector<unsigned int> indices;
+
+    template<typename T>
+    bool read(size_t& position, T& value) {
+        if (position + sizeof(T) > data.size()) return false;
+        std::memcpy(&value, data.data() + position, sizeof(T));
+        position += sizeof(T);
+        return true;
+    }
+    bool readString(size_t& position, std::string& text);
+
+    // Reads one record at the position, definitions are only resolved and everything else only run when asked
+    bool step(size_t& position, bool define, bool run);
+public:
+    DrawStreamPlayer() = default;
+
+    // Only the header, e.g. to size the window before there is a context to load into
+    static bool readHeader(const std::string& path, DrawStreamHeader& header);
+    bool load(const std::string& path);
+
+    inline int getFrameCount() const { return frameOffsets.size(); }
+    inline int getScreenWidth() const { return header.screenWidth; }
+    inline int getScreenHeight() const { return header.screenHeight; }
+
+    void replayFrame(int frame);
+    void clean();
+};
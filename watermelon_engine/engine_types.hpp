@@ -23,6 +23,19 @@ public:
     }
 };
 
+class UVRect
+{
+public:
+    glm::vec2 uv0, uv1;
+
+    UVRect() : uv0(0.f, 0.f), uv1(1.f, 1.f) {}
+    UVRect(glm::vec2 uv0, glm::vec2 uv1) : uv0(uv0), uv1(uv1) {}
+    // Normalizes a source rectangle in pixels, Y is flipped since textures are loaded bottom-up
+    UVRect(const Rectangle& source, float textureWidth, float textureHeight)
+        : uv0(source.getLeft() / textureWidth, 1.f - source.getBottom() / textureHeight),
+          uv1(source.getRight() / textureWidth, 1.f - source.getTop() / textureHeight) {}
+};
+
 class Color
 {
 public:
@@ -2,6 +2,15 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #include "core.hpp"
+#include "capture.hpp"
+#include "utils.hpp"
+#include "material.hpp"
+#include "gpu_timer.hpp"
+#include "draw_stream.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <glm/gtc/packing.hpp>
+#include <nlohmann/json.hpp>
 
 Shader::Shader(const char *vertexPath, const char *fragmentPath)
 {
@@ -23,19 +32,65 @@ Shader::Shader(const char *vertexPath, const char *fragmentPath)
 
     vertexShaderCode = vertStream.str();
     fragmentShaderCode = fragStream.str();
-    const char* cVertShaderCode = vertexShaderCode.c_str();
-    const char* cFragmentShaderCode = fragmentShaderCode.c_str();
 
+    build(vertexShaderCode.c_str(), fragmentShaderCode.c_str());
+}
+
+Shader Shader::fromSource(const std::string &vertexCode, const std::string &fragmentCode)
+{
+    Shader shader;
+    shader.build(vertexCode.c_str(), fragmentCode.c_str());
+    return shader;
+}
+
+Shader Shader::fromComputeSource(const std::string &computeCode)
+{
+    const char* code = computeCode.c_str();
+
+    unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(compute, 1, &code, nullptr);
+    glCompileShader(compute);
+
+    int compiled = 0;
+    glGetShaderiv(compute, GL_COMPILE_STATUS, &compiled);
+    if (!compiled) {
+        char log[1024];
+        glGetShaderInfoLog(compute, sizeof(log), nullptr, log);
+        SDL_Log("Failed to compile a compute shader! Error message: %s", log);
+    }
+
+    Shader shader;
+    shader.id = glCreateProgram();
+    glAttachShader(shader.id, compute);
+    glLinkProgram(shader.id);
+    glDeleteShader(compute);
+
+    return shader;
+}
+
+void Shader::build(const char *vertexCode, const char *fragmentCode)
+{
     unsigned int vertex, fragment;
 
     vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &cVertShaderCode, nullptr);
+    glShaderSource(vertex, 1, &vertexCode, nullptr);
     glCompileShader(vertex);
 
     fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &cFragmentShaderCode, nullptr);
+    glShaderSource(fragment, 1, &fragmentCode, nullptr);
     glCompileShader(fragment);
 
+    // Report compile errors, otherwise a broken shader silently draws nothing
+    for (unsigned int stage : { vertex, fragment }) {
+        int compiled = 0;
+        glGetShaderiv(stage, GL_COMPILE_STATUS, &compiled);
+        if (!compiled) {
+            char log[1024];
+            glGetShaderInfoLog(stage, sizeof(log), nullptr, log);
+            SDL_Log("Failed to compile a shader! Error message: %s", log);
+        }
+    }
+
     id = glCreateProgram();
     glAttachShader(id, vertex);
     glAttachShader(id, fragment);
@@ -48,6 +103,7 @@ Shader::Shader(const char *vertexPath, const char *fragmentPath)
 void Shader::use()
 {
     glUseProgram(id);
+    RenderStatistics::get().shaderBinds++;
 }
 
 void Shader::clean()
@@ -65,6 +121,16 @@ Texture::Texture(const char *path)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
+    reload(path);
+}
+
+void Texture::reload(const char *path)
+{
+    // Keeps whatever the caller had bound, reloads can happen in the middle of drawing
+    GLint previous;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous);
+    glBindTexture(GL_TEXTURE_2D, id);
+
     stbi_set_flip_vertically_on_load(true);
     unsigned char* data = stbi_load(path, &width, &height, &nrChannels, STBI_rgb_alpha);
     if (data) {
@@ -72,6 +138,23 @@ Texture::Texture(const char *path)
         glGenerateMipmap(GL_TEXTURE_2D);
     }
     stbi_image_free(data);
+
+    glBindTexture(GL_TEXTURE_2D, previous);
+}
+
+void Texture::releasePixels()
+{
+    GLint previous;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous);
+    glBindTexture(GL_TEXTURE_2D, id);
+
+    // Zero sized levels free the storage, size and parameters stay for the reload
+    int levels = 1 + (int)std::floor(std::log2(std::max(1, std::max(width, height))));
+    for (int level = 0; level < levels; level++) {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, previous);
 }
 
 Texture::Texture(unsigned char *data, float width, float height)
@@ -92,6 +175,27 @@ Texture::Texture(unsigned char *data, float width, float height)
 void Texture::bind()
 {
     glBindTexture(GL_TEXTURE_2D, id);
+    RenderStatistics::get().textureBinds++;
+    AssetManager::markTextureUsed(*this);
+}
+
+void Texture::setFilter(int filter)
+{
+    // Queued geometry has to be drawn while its own texture is still bound
+    ObjectDrawer::flush(FLUSH_REASON_STATE);
+    glBindTexture(GL_TEXTURE_2D, id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    ObjectDrawer::resetState();
+}
+
+void Texture::setWrap(int wrapS, int wrapT)
+{
+    ObjectDrawer::flush(FLUSH_REASON_STATE);
+    glBindTexture(GL_TEXTURE_2D, id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapS);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapT);
+    ObjectDrawer::resetState();
 }
 
 void Texture::clean()
@@ -99,9 +203,12 @@ void Texture::clean()
     glDeleteTextures(1, &id);
 }
 
-RenderTarget::RenderTarget(float width, float height)
+RenderTarget::RenderTarget(float width, float height, bool readableStencil)
     : width(width), height(height)
 {
+    // Pending geometry belongs to whatever target was bound before, not to this one
+    ObjectDrawer::flush(FLUSH_REASON_TARGET);
+
     // Generate framebuffer
     glGenFramebuffers(1, &FBO);
     glBindFramebuffer(GL_FRAMEBUFFER, FBO);
@@ -111,23 +218,37 @@ RenderTarget::RenderTarget(float width, float height)
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture.getId(), 0);
 
     // Create depth buffer
-    glGenRenderbuffers(1, &depthRBO);
-    glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+    if (readableStencil) {
+        glGenTextures(1, &depthStencilTexture);
+        glBindTexture(GL_TEXTURE_2D, depthStencilTexture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH24_STENCIL8, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_DEPTH_STENCIL_TEXTURE_MODE, GL_STENCIL_INDEX);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthStencilTexture, 0);
+    }
+    else {
+        glGenRenderbuffers(1, &depthRBO);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+    }
 
-    // Unbind
+    // Unbind, the attachments replaced the drawer's texture
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    ObjectDrawer::resetState();
 }
 
 void RenderTarget::use()
 {
+    ObjectDrawer::flush(FLUSH_REASON_TARGET);
     glBindFramebuffer(GL_FRAMEBUFFER, FBO);
     glViewport(0, 0, width, height);
 }
 
 void RenderTarget::unuse()
 {
+    ObjectDrawer::flush(FLUSH_REASON_TARGET);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     glViewport(0, 0, Engine::getScreenWidth(), Engine::getScreenHeight());
 }
@@ -136,7 +257,8 @@ void RenderTarget::clean()
 {
     glDeleteFramebuffers(1, &FBO);
     colorTexture.clean();
-    glDeleteRenderbuffers(1, &depthRBO);
+    if (depthRBO) glDeleteRenderbuffers(1, &depthRBO);
+    if (depthStencilTexture) glDeleteTextures(1, &depthStencilTexture);
 }
 
 void RenderTarget::draw(Camera &camera, glm::vec2 position, glm::vec2 scale, glm::vec2 origin)
@@ -144,6 +266,66 @@ void RenderTarget::draw(Camera &camera, glm::vec2 position, glm::vec2 scale, glm
     ObjectDrawer::drawTexture(camera, colorTexture, position, origin, scale, 0.f);
 }
 
+void RenderTarget::capture(FrameCapture &capture)
+{
+    capture.capture(FBO, width, height);
+}
+
+RenderTarget *RenderTargetPool::acquire(int width, int height)
+{
+    useCounter++;
+
+    for (std::unique_ptr<Entry>& entry : entries) {
+        if (!entry->inUse && (int)entry->target.getWidth() == width && (int)entry->target.getHeight() == height) {
+            entry->inUse = true;
+            entry->lastUsed = useCounter;
+            return &entry->target;
+        }
+    }
+
+    // Drop the least recently used free target when the pool is full
+    int unusedCount = 0;
+    int oldestIndex = -1;
+    for (int i = 0; i < entries.size(); i++) {
+        if (entries[i]->inUse) continue;
+
+        unusedCount++;
+        if (oldestIndex == -1 || entries[i]->lastUsed < entries[oldestIndex]->lastUsed) oldestIndex = i;
+    }
+
+    if (unusedCount >= maxUnused && oldestIndex != -1) {
+        entries[oldestIndex]->target.clean();
+        entries.erase(entries.begin() + oldestIndex);
+    }
+
+    std::unique_ptr<Entry> entry = std::make_unique<Entry>();
+    entry->target = RenderTarget(width, height);
+    entry->target.getTexture().setFilter(filter);
+    entry->inUse = true;
+    entry->lastUsed = useCounter;
+
+    entries.push_back(std::move(entry));
+    return &entries.back()->target;
+}
+
+void RenderTargetPool::release(RenderTarget *target)
+{
+    for (std::unique_ptr<Entry>& entry : entries) {
+        if (&entry->target == target) {
+            entry->inUse = false;
+            return;
+        }
+    }
+}
+
+void RenderTargetPool::clean()
+{
+    for (std::unique_ptr<Entry>& entry : entries) {
+        entry->target.clean();
+    }
+    entries.clear();
+}
+
 unsigned int ObjectDrawer::VAO;
 unsigned int ObjectDrawer::VBO;
 unsigned int ObjectDrawer::EBO;
@@ -152,22 +334,174 @@ Shader ObjectDrawer::defaultShader;
 Shader ObjectDrawer::solidColorShader;
 Shader ObjectDrawer::circleShader;
 
+RenderStats RenderStatistics::current = {};
+RenderStats RenderStatistics::history[RENDER_STATS_HISTORY] = {};
+int RenderStatistics::historyIndex = 0;
+int RenderStatistics::historyCount = 0;
+
+void RenderStatistics::beginFrame(unsigned long long frame)
+{
+    // The very first call has no finished frame yet
+    if (current.frame != 0 || current.drawCalls != 0) {
+        history[historyIndex] = current;
+        historyIndex = (historyIndex + 1) % RENDER_STATS_HISTORY;
+        historyCount = std::min(historyCount + 1, RENDER_STATS_HISTORY);
+    }
+
+    current = RenderStats{};
+    current.frame = frame;
+}
+
+const char *RenderStatistics::getFlushReasonName(FlushReason reason)
+{
+    switch (reason) {
+        case FLUSH_REASON_EXPLICIT: return "explicit";
+        case FLUSH_REASON_TEXTURE: return "texture";
+        case FLUSH_REASON_OVERFLOW: return "overflow";
+        case FLUSH_REASON_CAMERA: return "camera";
+        case FLUSH_REASON_STATE: return "state";
+        case FLUSH_REASON_TARGET: return "target";
+        case FLUSH_REASON_FRAME: return "frame";
+        default: return "unknown";
+    }
+}
+
+bool RenderStatistics::exportCSV(const std::string &path)
+{
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        SDL_Log("Failed to open %s for render statistics", path.c_str());
+        return false;
+    }
+
+    file << "frame,drawCalls,batches";
+    for (int reason = 0; reason < FLUSH_REASON_COUNT; reason++) {
+        file << ",flush_" << getFlushReasonName((FlushReason)reason);
+    }
+    file << ",vertices,instances,shaderBinds,textureBinds,uniformUploads,bytesStreamed,culledObjects\n";
+
+    for (int i = 0; i < historyCount; i++) {
+        const RenderStats& stats = getHistory(i);
+        file << stats.frame << "," << stats.drawCalls << "," << stats.batches;
+        for (int reason = 0; reason < FLUSH_REASON_COUNT; reason++) {
+            file << "," << stats.flushes[reason];
+        }
+        file << "," << stats.vertices << "," << stats.instances << "," << stats.shaderBinds << "," << stats.textureBinds
+             << "," << stats.uniformUploads << "," << stats.bytesStreamed << "," << stats.culledObjects << "\n";
+    }
+
+    return true;
+}
+
+bool RenderStatistics::exportJSON(const std::string &path)
+{
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        SDL_Log("Failed to open %s for render statistics", path.c_str());
+        return false;
+    }
+
+    nlohmann::ordered_json frames = nlohmann::ordered_json::array();
+    for (int i = 0; i < historyCount; i++) {
+        const RenderStats& stats = getHistory(i);
+
+        nlohmann::ordered_json flushes;
+        for (int reason = 0; reason < FLUSH_REASON_COUNT; reason++) {
+            flushes[getFlushReasonName((FlushReason)reason)] = stats.flushes[reason];
+        }
+
+        nlohmann::ordered_json frame;
+        frame["frame"] = stats.frame;
+        frame["drawCalls"] = stats.drawCalls;
+        frame["batches"] = stats.batches;
+        frame["flushes"] = flushes;
+        frame["vertices"] = stats.vertices;
+        frame["instances"] = stats.instances;
+        frame["shaderBinds"] = stats.shaderBinds;
+        frame["textureBinds"] = stats.textureBinds;
+        frame["uniformUploads"] = stats.uniformUploads;
+        frame["bytesStreamed"] = stats.bytesStreamed;
+        frame["culledObjects"] = stats.culledObjects;
+        frames.push_back(frame);
+    }
+
+    file << frames.dump(2);
+    return true;
+}
+
 Texture ObjectDrawer::currentTexture;
 Shader* ObjectDrawer::currentShader;
+Material* ObjectDrawer::currentMaterial = nullptr;
+Texture ObjectDrawer::whiteTexture;
+
+unsigned int ObjectDrawer::batchVAOs[VERTEX_FORMAT_COUNT];
+unsigned int ObjectDrawer::batchVBO;
+unsigned int ObjectDrawer::batchEBO;
+Shader ObjectDrawer::batchShader;
+Shader ObjectDrawer::batchPackedShader;
+
+VertexFormat ObjectDrawer::batchVertexFormat = VERTEX_FORMAT_COMPACT;
+std::vector<BatchVertex> ObjectDrawer::batchVertices;
+std::vector<unsigned short> ObjectDrawer::batchIndices;
+std::vector<unsigned char> ObjectDrawer::batchUpload;
+
+// GPU side layouts of the compact vertex formats
+struct CompactBatchVertex
+{
+    glm::vec3 position;
+    unsigned short texCoord[2];
+    unsigned char color[4];
+};
+
+struct PackedBatchVertex
+{
+    unsigned short position[2];
+    unsigned short depth;
+    unsigned short padding;
+    unsigned short texCoord[2];
+    unsigned char color[4];
+};
+
+static unsigned short toUnorm16(float value)
+{
+    return (unsigned short)std::round(glm::clamp(value, 0.f, 1.f) * 65535.f);
+}
+
+static unsigned char toUnorm8(float value)
+{
+    return (unsigned char)std::round(glm::clamp(value, 0.f, 1.f) * 255.f);
+}
+
+Texture ObjectDrawer::batchTexture;
+glm::mat4 ObjectDrawer::batchProjection;
+glm::mat4 ObjectDrawer::batchView;
+float ObjectDrawer::batchZoom = 1.f;
 
 void ObjectDrawer::initialize()
 {
     defaultShader = Shader("assets/shaders/default.vert", "assets/shaders/default.frag");
     solidColorShader = Shader("assets/shaders/shapes/shape.vert", "assets/shaders/shapes/shape.frag");
     circleShader = Shader("assets/shaders/shapes/shape.vert", "assets/shaders/shapes/circle.frag");
+    batchShader = Shader::fromSource(
+        ShaderPreprocessor::process("assets/shaders/batch.vert"),
+        ShaderPreprocessor::process("assets/shaders/batch.frag")
+    );
+    batchPackedShader = Shader::fromSource(
+        ShaderPreprocessor::process("assets/shaders/batch.vert", { "PACKED_POSITIONS" }),
+        ShaderPreprocessor::process("assets/shaders/batch.frag")
+    );
     currentShader = &defaultShader;
 
-    float vertices[] = {
+    unsigned char whitePixel[4] = { 255, 255, 255, 255 };
+    whiteTexture = Texture(whitePixel, 1, 1);
+
+    // Corners are only zeros and ones, so bytes are enough (padded to keep attributes 4 byte aligned)
+    unsigned char vertices[] = {
         // positions    // texture coords
-        0.f, 0.f, 0.f,  0.f, 1.f,
-        1.f, 0.f, 0.f,  1.f, 1.f,
-        1.f, 1.f, 0.f,  1.f, 0.f,
-        0.f, 1.f, 0.f,  0.f, 0.f
+        0, 0, 0, 0,     0, 1, 0, 0,
+        1, 0, 0, 0,     1, 1, 0, 0,
+        1, 1, 0, 0,     1, 0, 0, 0,
+        0, 1, 0, 0,     0, 0, 0, 0
     };
 
     unsigned int indices[] = {
@@ -191,12 +525,56 @@ void ObjectDrawer::initialize()
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
     
     // Set vertex attributes pointers
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+    glVertexAttribPointer(0, 3, GL_UNSIGNED_BYTE, GL_FALSE, 8, (void*)0);
     glEnableVertexAttribArray(0);
     // Set Texture vertex attributes
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+    glVertexAttribPointer(1, 2, GL_UNSIGNED_BYTE, GL_FALSE, 8, (void*)4);
     glEnableVertexAttribArray(1);
 
+    // Creating streamed buffers for batches, every vertex format reads the same buffers through its own VAO
+    glGenBuffers(1, &batchVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, batchVBO);
+    glBufferData(GL_ARRAY_BUFFER, BATCH_MAX_VERTICES * sizeof(BatchVertex), nullptr, GL_STREAM_DRAW);
+
+    glGenBuffers(1, &batchEBO);
+    glGenVertexArrays(VERTEX_FORMAT_COUNT, batchVAOs);
+
+    glBindVertexArray(batchVAOs[VERTEX_FORMAT_FLOAT]);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batchEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, BATCH_MAX_INDICES * sizeof(unsigned short), nullptr, GL_STREAM_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(BatchVertex), (void*)offsetof(BatchVertex, position));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(BatchVertex), (void*)offsetof(BatchVertex, texCoord));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(BatchVertex), (void*)offsetof(BatchVertex, color));
+    glEnableVertexAttribArray(2);
+
+    // Normalized attributes are unpacked to floats by the vertex fetch, the shader stays the same
+    glBindVertexArray(batchVAOs[VERTEX_FORMAT_COMPACT]);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batchEBO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(CompactBatchVertex), (void*)offsetof(CompactBatchVertex, position));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactBatchVertex), (void*)offsetof(CompactBatchVertex, texCoord));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(CompactBatchVertex), (void*)offsetof(CompactBatchVertex, color));
+    glEnableVertexAttribArray(2);
+
+    // Fixed-point positions are scaled back by batch.vert compiled with PACKED_POSITIONS
+    glBindVertexArray(batchVAOs[VERTEX_FORMAT_PACKED]);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batchEBO);
+    glVertexAttribPointer(0, 2, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(PackedBatchVertex), (void*)offsetof(PackedBatchVertex, position));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedBatchVertex), (void*)offsetof(PackedBatchVertex, texCoord));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(PackedBatchVertex), (void*)offsetof(PackedBatchVertex, color));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(3, 1, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedBatchVertex), (void*)offsetof(PackedBatchVertex, depth));
+    glEnableVertexAttribArray(3);
+
+    batchVertices.reserve(BATCH_MAX_VERTICES);
+    batchIndices.reserve(BATCH_MAX_INDICES);
+    batchUpload.reserve(BATCH_MAX_VERTICES * sizeof(BatchVertex));
+
     // Unbind
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
@@ -205,20 +583,56 @@ void ObjectDrawer::initialize()
 void ObjectDrawer::clean()
 {
     defaultShader.clean();
+    batchShader.clean();
+    batchPackedShader.clean();
+    whiteTexture.clean();
 
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
+
+    glDeleteVertexArrays(VERTEX_FORMAT_COUNT, batchVAOs);
+    glDeleteBuffers(1, &batchVBO);
+    glDeleteBuffers(1, &batchEBO);
+}
+
+void ObjectDrawer::setBatchVertexFormat(VertexFormat format)
+{
+    flush();
+    batchVertexFormat = format;
+    if (DrawStreamRecorder::isRecording()) DrawStreamRecorder::recordVertexFormat(format);
+}
+
+void ObjectDrawer::useMaterial(Material *material)
+{
+    if (!material) return;
+
+    if (currentMaterial == material) {
+        // Textures and the uniform buffer are still bound, the program is rebound by the draw if needed
+        material->upload();
+        return;
+    }
+
+    // Uniform buffers and units above zero aren't used by the batch, so pending geometry can stay queued
+    material->bind();
+    currentShader = material->getShader();
+    currentMaterial = material;
 }
 
 void ObjectDrawer::clearBackground(Color color)
 {
+    flush(FLUSH_REASON_STATE);
+    GpuScope scope("clear");
     glClearColor(color.r, color.g, color.b, color.a);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (DrawStreamRecorder::isRecording()) DrawStreamRecorder::recordClear(color);
 }
 
-void ObjectDrawer::drawTexture(Camera &camera, Texture &texture, glm::vec2 position, glm::vec2 origin, glm::vec2 scale, float rotation, Rectangle *source, bool flipH, bool flipV, Shader *shader, float depth)
+void ObjectDrawer::drawTexture(Camera &camera, Texture &texture, glm::vec2 position, glm::vec2 origin, glm::vec2 scale, float rotation, glm::vec2 sourceSize, const UVRect &uv, bool flipH, bool flipV, Shader *shader, float depth)
 {
+    flush(FLUSH_REASON_STATE);
+    if (DrawStreamRecorder::isRecording()) DrawStreamRecorder::recordTexture(camera, texture, position, origin, scale, rotation, sourceSize, uv, flipH, flipV, shader, depth);
+
     if (currentTexture != texture) {
         texture.bind();
         currentTexture = texture;
@@ -238,29 +652,11 @@ void ObjectDrawer::drawTexture(Camera &camera, Texture &texture, glm::vec2 posit
     currentShader->setMat4Uniform("projection", camera.getProjectionMatrix());
     currentShader->setMat4Uniform("view", camera.getViewMatrix());
 
-    // Source of texture
-    glm::vec2 sourceSize;
-    glm::vec2 uv0;
-    glm::vec2 uv1;
-
-    if (source != nullptr) {
-        sourceSize = glm::vec2{ source->width, source->height };
-
-        uv0 = glm::vec2{
-            source->getLeft() / texture.getWidth(),
-            1.f - source->getBottom() / texture.getHeight()
-        };
-        uv1 = glm::vec2{
-            source->getRight() / texture.getWidth(),
-            1.f - source->getTop() / texture.getHeight()
-        };
-    }
-    else {
-        sourceSize = glm::vec2{ texture.getWidth(), texture.getHeight() };
-
-        uv0 = glm::vec2{ 0, 0 };
-        uv1 = glm::vec2{ 1, 1 };
-    }
+    // Flipping is just swapping the edges of the source
+    glm::vec2 uv0 = uv.uv0;
+    glm::vec2 uv1 = uv.uv1;
+    if (flipH) std::swap(uv0.x, uv1.x);
+    if (flipV) std::swap(uv0.y, uv1.y);
 
     // Transformations
     glm::mat4 model(1.f);
@@ -277,6 +673,22 @@ void ObjectDrawer::drawTexture(Camera &camera, Texture &texture, glm::vec2 posit
 
     // Draw a texture
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    RenderStatistics::get().drawCalls++;
+    RenderStatistics::get().vertices += 4;
+}
+
+void ObjectDrawer::drawTexture(Camera &camera, Texture &texture, glm::vec2 position, glm::vec2 origin, glm::vec2 scale, float rotation, Rectangle *source, bool flipH, bool flipV, Shader *shader, float depth)
+{
+    // Source of texture
+    if (source != nullptr) {
+        glm::vec2 sourceSize = glm::vec2{ source->width, source->height };
+        UVRect uv(*source, texture.getWidth(), texture.getHeight());
+        drawTexture(camera, texture, position, origin, scale, rotation, sourceSize, uv, flipH, flipV, shader, depth);
+    }
+    else {
+        glm::vec2 sourceSize = glm::vec2{ texture.getWidth(), texture.getHeight() };
+        drawTexture(camera, texture, position, origin, scale, rotation, sourceSize, UVRect{}, flipH, flipV, shader, depth);
+    }
 }
 
 void ObjectDrawer::drawTexture(Camera &camera, Texture &texture, glm::vec2 position, glm::vec2 origin, glm::vec2 scale, float rotation, Rectangle *soruce, float depth)
@@ -306,6 +718,9 @@ void ObjectDrawer::drawTexture(Camera &camera, Texture &texture, glm::vec2 posit
 
 void ObjectDrawer::drawRectangle(Camera &camera, Rectangle rectangle, Color color, float layerDepth)
 {
+    flush(FLUSH_REASON_STATE);
+    if (DrawStreamRecorder::isRecording()) DrawStreamRecorder::recordRectangle(camera, rectangle, color, layerDepth);
+
     if (currentShader != &solidColorShader) {
         currentShader = &solidColorShader;
         currentShader->use();
@@ -322,10 +737,15 @@ void ObjectDrawer::drawRectangle(Camera &camera, Rectangle rectangle, Color colo
     currentShader->setVec4Uniform("color", color.toVec4());
 
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    RenderStatistics::get().drawCalls++;
+    RenderStatistics::get().vertices += 4;
 }
 
 void ObjectDrawer::drawCircle(Camera &camera, glm::vec2 position, float radius, Color color, float layerDepth)
 {
+    flush(FLUSH_REASON_STATE);
+    if (DrawStreamRecorder::isRecording()) DrawStreamRecorder::recordCircle(camera, position, radius, color, layerDepth);
+
     if (currentShader != &circleShader) {
         currentShader = &circleShader;
         currentShader->use();
@@ -342,6 +762,474 @@ void ObjectDrawer::drawCircle(Camera &camera, glm::vec2 position, float radius,
     currentShader->setVec4Uniform("color", color.toVec4());
 
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    RenderStatistics::get().drawCalls++;
+    RenderStatistics::get().vertices += 4;
+}
+
+void ObjectDrawer::submitBatch(Camera &camera, Texture &texture, const BatchVertex *vertices, int vertexCount, const unsigned int *indices, int indexCount, glm::vec3 offset)
+{
+    setBatchCamera(camera);
+    submitBatch(texture, vertices, vertexCount, indices, indexCount, offset);
+}
+
+void ObjectDrawer::submitBatch(Texture &texture, const BatchVertex *vertices, int vertexCount, const unsigned int *indices, int indexCount, glm::vec3 offset)
+{
+    if (vertexCount > BATCH_MAX_VERTICES || indexCount > BATCH_MAX_INDICES) {
+        SDL_Log("Geometry of %d vertices does not fit into a batch!", vertexCount);
+        return;
+    }
+
+    if (!batchVertices.empty()) {
+        bool overflow = batchVertices.size() + vertexCount > BATCH_MAX_VERTICES || batchIndices.size() + indexCount > BATCH_MAX_INDICES;
+        if (overflow) flush(FLUSH_REASON_OVERFLOW);
+        else if (batchTexture != texture) flush(FLUSH_REASON_TEXTURE);
+    }
+
+    batchTexture = texture;
+
+    unsigned int baseVertex = batchVertices.size();
+    for (int i = 0; i < vertexCount; i++) {
+        BatchVertex vertex = vertices[i];
+        vertex.position += offset;
+        batchVertices.push_back(vertex);
+    }
+
+    for (int i = 0; i < indexCount; i++) {
+        batchIndices.push_back((unsigned short)(baseVertex + indices[i]));
+    }
+
+    if (DrawStreamRecorder::isRecording()) DrawStreamRecorder::recordBatch(texture, vertices, vertexCount, indices, indexCount, offset);
+}
+
+void ObjectDrawer::setBatchCamera(Camera &camera)
+{
+    glm::mat4 projection = camera.getProjectionMatrix();
+    glm::mat4 view = camera.getViewMatrix();
+
+    if (!batchVertices.empty() && (batchProjection != projection || batchView != view)) flush(FLUSH_REASON_CAMERA);
+
+    batchProjection = projection;
+    batchView = view;
+    batchZoom = camera.getZoom();
+    if (DrawStreamRecorder::isRecording()) DrawStreamRecorder::recordBatchCamera(camera);
+}
+
+VertexFormat ObjectDrawer::chooseBatchFormat(glm::vec2 &origin)
+{
+    if (batchVertexFormat == VERTEX_FORMAT_FLOAT) return VERTEX_FORMAT_FLOAT;
+
+    glm::vec2 minPosition = glm::vec2{ std::numeric_limits<float>::max() };
+    glm::vec2 maxPosition = glm::vec2{ std::numeric_limits<float>::lowest() };
+    bool texCoordsInRange = true;
+    bool depthsExact = batchVertexFormat == VERTEX_FORMAT_PACKED;
+
+    for (const BatchVertex& vertex : batchVertices) {
+        glm::vec2 position = glm::vec2{ vertex.position.x, vertex.position.y };
+        minPosition = glm::min(minPosition, position);
+        maxPosition = glm::max(maxPosition, position);
+
+        if (vertex.texCoord.x < 0.f || vertex.texCoord.x > 1.f || vertex.texCoord.y < 0.f || vertex.texCoord.y > 1.f) {
+            texCoordsInRange = false;
+        }
+
+        // Layer depths have to survive the half float, otherwise sorting by depth would change
+        if (depthsExact && glm::unpackHalf1x16(glm::packHalf1x16(vertex.position.z)) != vertex.position.z) {
+            depthsExact = false;
+        }
+    }
+
+    // Repeating texture coordinates can't be normalized
+    if (!texCoordsInRange) return VERTEX_FORMAT_FLOAT;
+
+    origin = glm::floor(minPosition);
+    glm::vec2 extent = (maxPosition - origin) * BATCH_PACKED_SUBPIXELS;
+    if (depthsExact && std::abs(batchZoom) <= BATCH_PACKED_MAX_ZOOM && extent.x <= 65535.f && extent.y <= 65535.f) return VERTEX_FORMAT_PACKED;
+
+    return VERTEX_FORMAT_COMPACT;
+}
+
+size_t ObjectDrawer::packBatchVertices(VertexFormat format, glm::vec2 origin)
+{
+    switch (format) {
+        case VERTEX_FORMAT_COMPACT: {
+            batchUpload.resize(batchVertices.size() * sizeof(CompactBatchVertex));
+            CompactBatchVertex* packed = (CompactBatchVertex*)batchUpload.data();
+
+            for (int i = 0; i < batchVertices.size(); i++) {
+                const BatchVertex& vertex = batchVertices[i];
+                packed[i].position = vertex.position;
+                packed[i].texCoord[0] = toUnorm16(vertex.texCoord.x);
+                packed[i].texCoord[1] = toUnorm16(vertex.texCoord.y);
+                for (int c = 0; c < 4; c++) packed[i].color[c] = toUnorm8(vertex.color[c]);
+            }
+
+            return batchUpload.size();
+        }
+        case VERTEX_FORMAT_PACKED: {
+            batchUpload.resize(batchVertices.size() * sizeof(PackedBatchVertex));
+            PackedBatchVertex* packed = (PackedBatchVertex*)batchUpload.data();
+
+            for (int i = 0; i < batchVertices.size(); i++) {
+                const BatchVertex& vertex = batchVertices[i];
+                packed[i].position[0] = (unsigned short)std::round((vertex.position.x - origin.x) * BATCH_PACKED_SUBPIXELS);
+                packed[i].position[1] = (unsigned short)std::round((vertex.position.y - origin.y) * BATCH_PACKED_SUBPIXELS);
+                packed[i].depth = glm::packHalf1x16(vertex.position.z);
+                packed[i].padding = 0;
+                packed[i].texCoord[0] = toUnorm16(vertex.texCoord.x);
+                packed[i].texCoord[1] = toUnorm16(vertex.texCoord.y);
+                for (int c = 0; c < 4; c++) packed[i].color[c] = toUnorm8(vertex.color[c]);
+            }
+
+            return batchUpload.size();
+        }
+        default: {
+            return batchVertices.size() * sizeof(BatchVertex);
+        }
+    }
+}
+
+void ObjectDrawer::flush(FlushReason reason)
+{
+    if (batchVertices.empty()) return;
+    if (DrawStreamRecorder::isRecording()) DrawStreamRecorder::recordFlush(reason);
+
+    glm::vec2 origin = glm::vec2{ 0 };
+    VertexFormat format = chooseBatchFormat(origin);
+    size_t uploadSize = packBatchVertices(format, origin);
+    const void* uploadData = format == VERTEX_FORMAT_FLOAT ? (const void*)batchVertices.data() : (const void*)batchUpload.data();
+
+    Shader* shader = format == VERTEX_FORMAT_PACKED ? &batchPackedShader : &batchShader;
+    if (currentShader != shader) {
+        currentShader = shader;
+        currentShader->use();
+    }
+
+    if (currentTexture != batchTexture) {
+        batchTexture.bind();
+        currentTexture = batchTexture;
+    }
+
+    currentShader->setMat4Uniform("projection", batchProjection);
+    currentShader->setMat4Uniform("view", batchView);
+    if (format == VERTEX_FORMAT_PACKED) {
+        currentShader->setVec2Uniform("positionOrigin", origin);
+        currentShader->setFloatUniform("positionScale", 1.f / BATCH_PACKED_SUBPIXELS);
+    }
+
+    glBindVertexArray(batchVAOs[format]);
+
+    // Orphan the buffers so the driver doesn't wait for the previous batch
+    glBindBuffer(GL_ARRAY_BUFFER, batchVBO);
+    glBufferData(GL_ARRAY_BUFFER, BATCH_MAX_VERTICES * sizeof(BatchVertex), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, uploadSize, uploadData);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, BATCH_MAX_INDICES * sizeof(unsigned short), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, batchIndices.size() * sizeof(unsigned short), batchIndices.data());
+
+    glDrawElements(GL_TRIANGLES, batchIndices.size(), GL_UNSIGNED_SHORT, 0);
+
+    RenderStats& stats = RenderStatistics::get();
+    stats.flushes[reason]++;
+    stats.batches++;
+    stats.drawCalls++;
+    stats.vertices += batchVertices.size();
+    stats.bytesStreamed += uploadSize + batchIndices.size() * sizeof(unsigned short);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(VAO);
+
+    batchVertices.clear();
+    batchIndices.clear();
+}
+
+// Two triangles per quad, same winding as the default quad
+static const unsigned int nineSliceIndices[54] = {
+    0, 1, 3, 1, 2, 3,
+    4, 5, 7, 5, 6, 7,
+    8, 9, 11, 9, 10, 11,
+    12, 13, 15, 13, 14, 15,
+    16, 17, 19, 17, 18, 19,
+    20, 21, 23, 21, 22, 23,
+    24, 25, 27, 25, 26, 27,
+    28, 29, 31, 29, 30, 31,
+    32, 33, 35, 33, 34, 35
+};
+
+void NineSlice::setRegion(TextureAtlas *atlas, int regionIndex)
+{
+    this->atlas = atlas;
+    this->regionIndex = regionIndex;
+    dirty = true;
+}
+
+void NineSlice::setInsets(float left, float top, float right, float bottom)
+{
+    if (this->left == left && this->top == top && this->right == right && this->bottom == bottom) return;
+
+    this->left = left;
+    this->top = top;
+    this->right = right;
+    this->bottom = bottom;
+    dirty = true;
+}
+
+void NineSlice::setSize(glm::vec2 size)
+{
+    if (this->size == size) return;
+
+    this->size = size;
+    dirty = true;
+}
+
+void NineSlice::setColor(Color color)
+{
+    this->color = color;
+    dirty = true;
+}
+
+void NineSlice::rebuild()
+{
+    Rectangle region = atlas->getRegion(regionIndex);
+    float textureWidth = atlas->getTexture().getWidth();
+    float textureHeight = atlas->getTexture().getHeight();
+
+    // Borders are shrinked if the slice is smaller than them
+    float scaleX = left + right > size.x ? size.x / (left + right) : 1.f;
+    float scaleY = top + bottom > size.y ? size.y / (top + bottom) : 1.f;
+
+    float xs[4] = { 0.f, left * scaleX, size.x - right * scaleX, size.x };
+    float ys[4] = { 0.f, top * scaleY, size.y - bottom * scaleY, size.y };
+
+    float us[4] = {
+        region.getLeft() / textureWidth,
+        (region.getLeft() + left) / textureWidth,
+        (region.getRight() - right) / textureWidth,
+        region.getRight() / textureWidth
+    };
+    float vs[4] = {
+        1.f - region.getTop() / textureHeight,
+        1.f - (region.getTop() + top) / textureHeight,
+        1.f - (region.getBottom() - bottom) / textureHeight,
+        1.f - region.getBottom() / textureHeight
+    };
+
+    glm::vec4 vertexColor = color.toVec4();
+
+    for (int row = 0; row < 3; row++) {
+        for (int column = 0; column < 3; column++) {
+            BatchVertex* quad = &vertices[(row * 3 + column) * 4];
+            quad[0] = { glm::vec3{ xs[column], ys[row], 0.f }, glm::vec2{ us[column], vs[row] }, vertexColor };
+            quad[1] = { glm::vec3{ xs[column + 1], ys[row], 0.f }, glm::vec2{ us[column + 1], vs[row] }, vertexColor };
+            quad[2] = { glm::vec3{ xs[column + 1], ys[row + 1], 0.f }, glm::vec2{ us[column + 1], vs[row + 1] }, vertexColor };
+            quad[3] = { glm::vec3{ xs[column], ys[row + 1], 0.f }, glm::vec2{ us[column], vs[row + 1] }, vertexColor };
+        }
+    }
+
+    dirty = false;
+}
+
+void NineSlice::draw(Camera &camera, glm::vec2 position, float depth)
+{
+    if (!atlas) return;
+    if (dirty) rebuild();
+
+    ObjectDrawer::submitBatch(camera, atlas->getTexture(), vertices, 36, nineSliceIndices, 54, glm::vec3{ position, depth });
+}
+
+void Polygon::setPoints(const std::vector<glm::vec2> &points)
+{
+    this->points = points;
+    version++;
+}
+
+void Polygon::setPoint(int index, glm::vec2 point)
+{
+    if (points[index] == point) return;
+
+    points[index] = point;
+    version++;
+}
+
+void Polygon::insertPoint(int index, glm::vec2 point)
+{
+    points.insert(points.begin() + index, point);
+    version++;
+}
+
+void Polygon::removePoint(int index)
+{
+    points.erase(points.begin() + index);
+    version++;
+}
+
+void Polygon::setColor(Color color)
+{
+    this->color = color;
+    verticesDirty = true;
+}
+
+void Polygon::setTexture(Texture *texture)
+{
+    this->texture = texture;
+    verticesDirty = true;
+}
+
+int Polygon::getTriangleCount()
+{
+    if (!triangulated || triangulatedVersion != version) triangulate();
+    return indices.size() / 3;
+}
+
+float Polygon::getSignedArea(const std::vector<glm::vec2> &points)
+{
+    float area = 0.f;
+    for (int i = 0; i < points.size(); i++) {
+        const glm::vec2& a = points[i];
+        const glm::vec2& b = points[(i + 1) % points.size()];
+        area += a.x * b.y - b.x * a.y;
+    }
+    return area / 2.f;
+}
+
+static float edgeCross(glm::vec2 a, glm::vec2 b, glm::vec2 c)
+{
+    return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+bool Polygon::isEar(const std::vector<int> &remaining, int index) const
+{
+    int count = remaining.size();
+    int previous = remaining[(index + count - 1) % count];
+    int current = remaining[index];
+    int next = remaining[(index + 1) % count];
+
+    glm::vec2 a = points[previous];
+    glm::vec2 b = points[current];
+    glm::vec2 c = points[next];
+
+    // Reflex corners can't be cut off
+    if (edgeCross(a, b, c) <= 0.f) return false;
+
+    for (int vertex : remaining) {
+        if (vertex == previous || vertex == current || vertex == next) continue;
+
+        glm::vec2 p = points[vertex];
+        if (edgeCross(a, b, p) >= 0.f && edgeCross(b, c, p) >= 0.f && edgeCross(c, a, p) >= 0.f) return false;
+    }
+
+    return true;
+}
+
+void Polygon::triangulate()
+{
+    indices.clear();
+    triangulatedVersion = version;
+    triangulated = true;
+    verticesDirty = true;
+
+    int count = points.size();
+    if (count < 3) return;
+    indices.reserve((count - 2) * 3);
+
+    // Ears are looked for with positive winding, so flip the order of counter clockwise points
+    std::vector<int> remaining(count);
+    for (int i = 0; i < count; i++) remaining[i] = i;
+    if (getSignedArea(points) < 0.f) std::reverse(remaining.begin(), remaining.end());
+
+    int index = 0;
+    int misses = 0;
+    while (remaining.size() > 3) {
+        int size = remaining.size();
+        if (isEar(remaining, index)) {
+            indices.push_back(remaining[(index + size - 1) % size]);
+            indices.push_back(remaining[index]);
+            indices.push_back(remaining[(index + 1) % size]);
+
+            remaining.erase(remaining.begin() + index);
+            index %= size - 1;
+            misses = 0;
+            continue;
+        }
+
+        index = (index + 1) % size;
+        // A full loop without an ear means the edges cross or points repeat
+        if (++misses > size) {
+            SDL_Log("Failed to triangulate a polygon of %d points, its edges may cross", count);
+            break;
+        }
+    }
+
+    if (remaining.size() == 3) {
+        indices.push_back(remaining[0]);
+        indices.push_back(remaining[1]);
+        indices.push_back(remaining[2]);
+    }
+}
+
+void Polygon::rebuildVertices()
+{
+    glm::vec4 vertexColor = color.toVec4();
+    glm::vec2 textureSize = texture ? glm::vec2{ texture->getWidth(), texture->getHeight() } : glm::vec2{ 1.f };
+
+    vertices.resize(points.size());
+    for (int i = 0; i < points.size(); i++) {
+        glm::vec2 uv = texture ? glm::vec2{ points[i].x / textureSize.x, 1.f - points[i].y / textureSize.y } : glm::vec2{ .5f };
+        vertices[i] = { glm::vec3{ points[i], 0.f }, uv, vertexColor };
+    }
+
+    verticesDirty = false;
+}
+
+void Polygon::draw(Camera &camera, glm::vec2 position, float depth)
+{
+    if (!triangulated || triangulatedVersion != version) triangulate();
+    if (indices.empty()) return;
+    if (verticesDirty) rebuildVertices();
+
+    Texture& batchTexture = texture ? *texture : ObjectDrawer::getWhiteTexture();
+    ObjectDrawer::submitBatch(camera, batchTexture, vertices.data(), vertices.size(), indices.data(), indices.size(), glm::vec3{ position, depth });
+}
+
+// Rows from top to bottom, three bits each with the left pixel first
+static const char* pixelFontCharacters = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ.,:-+/()=!?_%";
+static const unsigned short pixelFontGlyphs[] = {
+    0x7B6F, 0x2C97, 0x73E7, 0x73CF, 0x5BC9, 0x79CF, 0x79EF, 0x7249,
+    0x7BEF, 0x7BCF, 0x2BED, 0x6BAE, 0x3923, 0x6B6E, 0x79A7, 0x79A4,
+    0x396B, 0x5BED, 0x7497, 0x126A, 0x5BAD, 0x4927, 0x5FED, 0x6B6D,
+    0x2B6A, 0x6BA4, 0x2B73, 0x6BAD, 0x388E, 0x7492, 0x5B6F, 0x5B6A,
+    0x5BFD, 0x5AAD, 0x5A92, 0x72A7, 0x0002, 0x0014, 0x0410, 0x01C0,
+    0x05D0, 0x12A4, 0x1491, 0x4494, 0x0E38, 0x2482, 0x6282, 0x0007,
+    0x52A5,
+};
+
+unsigned short PixelFont::getGlyph(char character)
+{
+    if (character >= 'a' && character <= 'z') character -= 'a' - 'A';
+
+    for (int i = 0; pixelFontCharacters[i]; i++) {
+        if (pixelFontCharacters[i] == character) return pixelFontGlyphs[i];
+    }
+    // Question mark for anything unknown
+    return character == ' ' ? 0 : pixelFontGlyphs[46];
+}
+
+glm::vec2 PixelFont::measure(const std::string &text, float pixelSize)
+{
+    int lineCount = 1;
+    int lineLength = 0;
+    int longestLine = 0;
+    for (char character : text) {
+        if (character == '\n') {
+            lineCount++;
+            lineLength = 0;
+            continue;
+        }
+        longestLine = std::max(longestLine, ++lineLength);
+    }
+
+    // No spacing after the last glyph or below the last line
+    float width = longestLine > 0 ? longestLine * (PIXEL_FONT_GLYPH_WIDTH + 1) - 1 : 0;
+    float height = lineCount * (PIXEL_FONT_GLYPH_HEIGHT + 1) - 1;
+    return glm::vec2{ width, height } * pixelSize;
 }
 
 TextureAtlas TextureAtlas::createGrid(Texture texture, int cellWidth, int cellHeight)
@@ -369,14 +1257,16 @@ TextureAtlas TextureAtlas::createGrid(Texture texture, int cellWidth, int cellHe
 void TextureAtlas::addRegion(Rectangle source)
 {
     regions.push_back(source);
+    uvRegions.push_back(UVRect{ source, texture.getWidth(), texture.getHeight() });
 }
 
 void TextureAtlas::addRegion(float x, float y, float width, float height)
 {
-    regions.push_back(Rectangle{ x, y, width, height });
+    addRegion(Rectangle{ x, y, width, height });
 }
 
 void TextureAtlas::removeRegion(int index)
 {
     regions.erase(regions.begin() + index);
+    uvRegions.erase(uvRegions.begin() + index);
 }
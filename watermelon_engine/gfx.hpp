@@ -7,6 +7,86 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glad/gl.h>
 #include <unordered_map>
+#include <vector>
+#include <limits>
+#include <memory>
+
+#define BATCH_MAX_VERTICES 16384
+#define BATCH_MAX_INDICES (BATCH_MAX_VERTICES / 4 * 6)
+// Packed positions are stored in 1/8 pixel steps from the batch's corner
+#define BATCH_PACKED_SUBPIXELS 8.f
+// Above this zoom a 1/8 step is more than a screen pixel and packed sprites would visibly jitter
+#define BATCH_PACKED_MAX_ZOOM BATCH_PACKED_SUBPIXELS
+
+// How batched vertices are laid out in GPU memory, formats fall back to a wider one if a batch doesn't fit them
+enum VertexFormat {
+    // Float position, texture coordinates and color, 36 bytes
+    VERTEX_FORMAT_FLOAT,
+    // Float position, 16-bit normalized texture coordinates and RGBA8 color, 20 bytes
+    VERTEX_FORMAT_COMPACT,
+    // 16-bit fixed-point position with half float depth, otherwise compact, 16 bytes
+    VERTEX_FORMAT_PACKED,
+    VERTEX_FORMAT_COUNT
+};
+
+// Why pending batched geometry was drawn
+enum FlushReason {
+    // flush() called directly, e.g. by timers and captures
+    FLUSH_REASON_EXPLICIT,
+    FLUSH_REASON_TEXTURE,
+    FLUSH_REASON_OVERFLOW,
+    FLUSH_REASON_CAMERA,
+    // An unbatched draw needed the GL state
+    FLUSH_REASON_STATE,
+    FLUSH_REASON_TARGET,
+    FLUSH_REASON_FRAME,
+    FLUSH_REASON_COUNT
+};
+
+// Frames kept for export
+#define RENDER_STATS_HISTORY 300
+
+struct RenderStats
+{
+    unsigned long long frame;
+    int drawCalls;
+    // Draw calls made by flushing the batch
+    int batches;
+    int flushes[FLUSH_REASON_COUNT];
+    long long vertices;
+    long long instances;
+    int shaderBinds;
+    int textureBinds;
+    int uniformUploads;
+    size_t bytesStreamed;
+    int culledObjects;
+};
+
+// Counters of what the renderer did this frame, reset by beginFrame() at the start of every frame.
+// Counters are plain ints bumped by the drawer, in Game::runThreaded() only the render thread may read them.
+class RenderStatistics
+{
+private:
+    static RenderStats current;
+    static RenderStats history[RENDER_STATS_HISTORY];
+    static int historyIndex;
+    static int historyCount;
+public:
+    // Current frame, also used by the renderer to count
+    static RenderStats& get() { return current; }
+    // Last finished frame, the current one is still being counted
+    static const RenderStats& getLastFrame() { return history[(historyIndex + RENDER_STATS_HISTORY - 1) % RENDER_STATS_HISTORY]; }
+    static int getHistoryCount() { return historyCount; }
+    // Zero is the oldest frame kept
+    static const RenderStats& getHistory(int index) { return history[(historyIndex - historyCount + index + RENDER_STATS_HISTORY) % RENDER_STATS_HISTORY]; }
+
+    static void beginFrame(unsigned long long frame);
+    static const char* getFlushReasonName(FlushReason reason);
+
+    // Write the kept frames, oldest first
+    static bool exportCSV(const std::string& path);
+    static bool exportJSON(const std::string& path);
+};
 
 class Shader
 {
@@ -14,6 +94,8 @@ private:
     unsigned int id;
     std::unordered_map<std::string, int> uniformLocations;
 
+    void build(const char* vertexCode, const char* fragmentCode);
+
     void cacheParameterLocation(std::string name) {
         if (!uniformLocations.contains(name)) {
             uniformLocations.insert({ name, glGetUniformLocation(id, name.c_str()) });
@@ -23,6 +105,10 @@ public:
     Shader() = default;
     Shader(const char* vertexPath, const char* fragmentPath);
 
+    // For code that didn't come straight from a file, e.g. after ShaderPreprocessor
+    static Shader fromSource(const std::string& vertexCode, const std::string& fragmentCode);
+    static Shader fromComputeSource(const std::string& computeCode);
+
     inline unsigned int getId() const { return id; }
 
     void use();
@@ -31,36 +117,43 @@ public:
     void setBoolUniform(const std::string& name, const bool& value) {
         cacheParameterLocation(name);
         glUniform1i(uniformLocations[name], value);
+        RenderStatistics::get().uniformUploads++;
     }
 
     void setIntUniform(const std::string& name, const int& value) {
         cacheParameterLocation(name);
         glUniform1i(uniformLocations[name], value);
+        RenderStatistics::get().uniformUploads++;
     }
 
     void setFloatUniform(const std::string& name, const float& value) {
         cacheParameterLocation(name);
         glUniform1f(uniformLocations[name], value);
+        RenderStatistics::get().uniformUploads++;
     }
 
     void setVec2Uniform(const std::string& name, const glm::vec2& value) {
         cacheParameterLocation(name);
         glUniform2fv(uniformLocations[name], 1, glm::value_ptr(value));
+        RenderStatistics::get().uniformUploads++;
     }
 
     void setVec3Uniform(const std::string& name, const glm::vec3& value) {
         cacheParameterLocation(name);
         glUniform3fv(uniformLocations[name], 1, glm::value_ptr(value));
+        RenderStatistics::get().uniformUploads++;
     }
 
     void setVec4Uniform(const std::string& name, const glm::vec4& value) {
         cacheParameterLocation(name);
         glUniform4fv(uniformLocations[name], 1, glm::value_ptr(value));
+        RenderStatistics::get().uniformUploads++;
     }
 
     void setMat4Uniform(const std::string& name, const glm::mat4& value) {
         cacheParameterLocation(name);
         glUniformMatrix4fv(uniformLocations[name], 1, GL_FALSE, glm::value_ptr(value));
+        RenderStatistics::get().uniformUploads++;
     }
 
     bool operator==(const Shader& other) const {
@@ -72,10 +165,11 @@ public:
 class Texture
 {
 private:
-    unsigned int id;
-    int width;
-    int height;
-    int nrChannels;
+    // Zero means no texture
+    unsigned int id = 0;
+    int width = 0;
+    int height = 0;
+    int nrChannels = 0;
 public:
     Texture() = default;
     Texture(const char* path);
@@ -86,7 +180,15 @@ public:
     inline float getWidth() const { return width; }
     inline float getHeight() const { return height; }
 
+    // Loads the pixels again into the same GL name, used for textures the asset manager evicted
+    void reload(const char* path);
+    void releasePixels();
+
     void bind();
+    void setFilter(int filter);
+    // GL_REPEAT, GL_MIRRORED_REPEAT or GL_CLAMP_TO_EDGE, loaded textures start mirrored
+    void setWrap(int wrapS, int wrapT);
+    void setWrap(int wrap) { setWrap(wrap, wrap); }
     void clean();
 
     bool operator==(const Texture& other) const {
@@ -100,6 +202,7 @@ class TextureAtlas
 private:
     Texture texture;
     std::vector<Rectangle> regions;
+    std::vector<UVRect> uvRegions;
 public:
     TextureAtlas(Texture texture) : texture(texture) {}
 
@@ -108,6 +211,7 @@ public:
     inline Texture& getTexture() { return texture; }
 
     Rectangle& getRegion(int index) { return regions[index]; }
+    UVRect& getRegionUV(int index) { return uvRegions[index]; }
     int getRegionCount() { return regions.size(); }
 
     void addRegion(Rectangle source);
@@ -116,7 +220,122 @@ public:
 };
 
 
+#define PIXEL_FONT_GLYPH_WIDTH 3
+#define PIXEL_FONT_GLYPH_HEIGHT 5
+
+// Tiny built in font for debug text and UI. Glyphs are 15 bit masks, rows from top to bottom with the left pixel first.
+class PixelFont
+{
+public:
+    // Digits, latin letters (lowercase shows as uppercase) and basic punctuation, anything else is a question mark
+    static unsigned short getGlyph(char character);
+    static bool isPixelSet(unsigned short glyph, int column, int row) {
+        int bit = (PIXEL_FONT_GLYPH_HEIGHT - 1 - row) * PIXEL_FONT_GLYPH_WIDTH + (PIXEL_FONT_GLYPH_WIDTH - 1 - column);
+        return glyph & (1 << bit);
+    }
+    // Glyphs are one pixel apart, lines too
+    static glm::vec2 measure(const std::string& text, float pixelSize);
+};
+
+
 class Camera;
+class FrameCapture;
+class Material;
+
+
+struct BatchVertex
+{
+    glm::vec3 position;
+    glm::vec2 texCoord;
+    glm::vec4 color;
+};
+
+
+class NineSlice
+{
+private:
+    TextureAtlas* atlas = nullptr;
+    int regionIndex = 0;
+
+    // Borders of the region in pixels, they keep their size while the center stretches
+    float left = 0, top = 0, right = 0, bottom = 0;
+    glm::vec2 size = glm::vec2{ 0 };
+    Color color = Color{ 1.f, 1.f, 1.f };
+
+    bool dirty = true;
+    BatchVertex vertices[36];
+
+    void rebuild();
+public:
+    NineSlice() = default;
+    NineSlice(TextureAtlas* atlas, int regionIndex, float left, float top, float right, float bottom, glm::vec2 size)
+        : atlas(atlas), regionIndex(regionIndex), left(left), top(top), right(right), bottom(bottom), size(size) {}
+
+    inline TextureAtlas* getAtlas() { return atlas; }
+    inline int getRegionIndex() const { return regionIndex; }
+    void setRegion(TextureAtlas* atlas, int regionIndex);
+
+    inline glm::vec4 getInsets() const { return glm::vec4{ left, top, right, bottom }; }
+    void setInsets(float left, float top, float right, float bottom);
+
+    inline glm::vec2 getSize() const { return size; }
+    void setSize(glm::vec2 size);
+
+    inline Color getColor() const { return color; }
+    void setColor(Color color);
+
+    void draw(Camera& camera, glm::vec2 position, float depth = 0);
+};
+
+
+// Filled simple polygon (edges must not cross, holes aren't supported) for terrain and destructible shapes.
+// It is triangulated by ear clipping only after its points change, the cached geometry goes through the batch.
+class Polygon
+{
+private:
+    std::vector<glm::vec2> points;
+    Color color = Color{ 1.f, 1.f, 1.f };
+    // Optional, tiled in local space with one texel per unit
+    Texture* texture = nullptr;
+
+    // Bumped whenever points change, triangulation is redone only when it differs from the built one
+    unsigned int version = 0;
+    unsigned int triangulatedVersion = 0;
+    bool triangulated = false;
+    bool verticesDirty = true;
+
+    std::vector<BatchVertex> vertices;
+    std::vector<unsigned int> indices;
+
+    bool isEar(const std::vector<int>& remaining, int index) const;
+    void triangulate();
+    void rebuildVertices();
+public:
+    Polygon() = default;
+    Polygon(std::vector<glm::vec2> points, Color color) : points(points), color(color) {}
+
+    inline const std::vector<glm::vec2>& getPoints() const { return points; }
+    void setPoints(const std::vector<glm::vec2>& points);
+    inline int getPointCount() const { return points.size(); }
+    inline glm::vec2 getPoint(int index) const { return points[index]; }
+    void setPoint(int index, glm::vec2 point);
+    void insertPoint(int index, glm::vec2 point);
+    void removePoint(int index);
+
+    inline unsigned int getVersion() const { return version; }
+
+    inline Color getColor() const { return color; }
+    void setColor(Color color);
+
+    inline Texture* getTexture() { return texture; }
+    void setTexture(Texture* texture);
+
+    int getTriangleCount();
+    // Positive for clockwise points on screen, since Y goes down
+    static float getSignedArea(const std::vector<glm::vec2>& points);
+
+    void draw(Camera& camera, glm::vec2 position, float depth = 0);
+};
 
 
 class RenderTarget
@@ -124,22 +343,55 @@ class RenderTarget
 private:
     unsigned int FBO;
     Texture colorTexture;
-    unsigned int depthRBO;
+    unsigned int depthRBO = 0;
+    // Used instead of the renderbuffer when depth and stencil have to be read back
+    unsigned int depthStencilTexture = 0;
 
     float width;
     float height;
 public:
     RenderTarget() = default;
-    RenderTarget(float width, float height);
+    RenderTarget(float width, float height, bool readableStencil = false);
 
     inline float getWidth() const { return width; }
     inline float getHeight() const { return height; }
 
+    inline Texture& getTexture() { return colorTexture; }
+    // Zero unless created with a readable stencil, samples stencil values through a usampler2D
+    inline unsigned int getStencilTexture() const { return depthStencilTexture; }
+
     void use();
     void unuse();
     void clean();
 
     void draw(Camera& camera, glm::vec2 position, glm::vec2 scale, glm::vec2 origin);
+    void capture(FrameCapture& capture);
+};
+
+
+// Keeps render targets of previously requested sizes around, so switching between a few sizes doesn't reallocate
+class RenderTargetPool
+{
+private:
+    struct Entry
+    {
+        RenderTarget target;
+        bool inUse;
+        unsigned long long lastUsed;
+    };
+
+    std::vector<std::unique_ptr<Entry>> entries;
+    unsigned long long useCounter = 0;
+    int maxUnused;
+    int filter;
+public:
+    RenderTargetPool(int maxUnused = 4, int filter = GL_LINEAR) : maxUnused(maxUnused), filter(filter) {}
+
+    inline int getTargetCount() const { return entries.size(); }
+
+    RenderTarget* acquire(int width, int height);
+    void release(RenderTarget* target);
+    void clean();
 };
 
 
@@ -184,6 +436,26 @@ public:
     glm::mat4 getProjectionMatrix() {
         return glm::ortho(0.f, width, height, 0.f, -9999.f, 9999.f);
     }
+
+    // World space area seen by the camera, rotated views give their enclosing box
+    Rectangle getVisibleBounds() const {
+        float angle = glm::radians(-rotation);
+        float cosine = std::cos(angle);
+        float sine = std::sin(angle);
+
+        glm::vec2 corners[4] = { { 0.f, 0.f }, { width, 0.f }, { width, height }, { 0.f, height } };
+        glm::vec2 min = glm::vec2{ std::numeric_limits<float>::max() };
+        glm::vec2 max = glm::vec2{ std::numeric_limits<float>::lowest() };
+
+        for (const glm::vec2& corner : corners) {
+            glm::vec2 local = (corner - position - origin) / zoom;
+            glm::vec2 world = glm::vec2{ local.x * cosine - local.y * sine, local.x * sine + local.y * cosine };
+            min = glm::min(min, world);
+            max = glm::max(max, world);
+        }
+
+        return Rectangle{ min.x, min.y, max.x - min.x, max.y - min.y };
+    }
 };
 
 
@@ -200,13 +472,59 @@ private:
 
     static Texture currentTexture;
     static Shader* currentShader;
+    static Material* currentMaterial;
+    // 1x1 white pixel, lets untextured geometry share the textured batch
+    static Texture whiteTexture;
+
+    // Batched geometry is kept on CPU until something forces a flush
+    static unsigned int batchVAOs[VERTEX_FORMAT_COUNT];
+    static unsigned int batchVBO;
+    static unsigned int batchEBO;
+    static Shader batchShader;
+    static Shader batchPackedShader;
+
+    static VertexFormat batchVertexFormat;
+    static std::vector<BatchVertex> batchVertices;
+    static std::vector<unsigned short> batchIndices;
+    static std::vector<unsigned char> batchUpload;
+
+    static VertexFormat chooseBatchFormat(glm::vec2& origin);
+    static size_t packBatchVertices(VertexFormat format, glm::vec2 origin);
+    static Texture batchTexture;
+    static glm::mat4 batchProjection;
+    static glm::mat4 batchView;
+    static float batchZoom;
 public:
     static void initialize();
     static void clean();
     static void bindVertexArray() { glBindVertexArray(VAO); }
+    // Call after binding programs or textures outside of the drawer so the next draw binds its own again
+    static void resetState() {
+        flush();
+        currentShader = nullptr;
+        currentTexture = Texture{};
+        currentMaterial = nullptr;
+    }
 
     static void clearBackground(Color color);
 
+    // Queues already transformed geometry, consecutive submissions with the same texture and camera become one draw call
+    static void submitBatch(Camera& camera, Texture& texture, const BatchVertex* vertices, int vertexCount, const unsigned int* indices, int indexCount, glm::vec3 offset = glm::vec3{ 0 });
+    // Same as above for the camera set by setBatchCamera, so matrices aren't rebuilt per submission
+    static void submitBatch(Texture& texture, const BatchVertex* vertices, int vertexCount, const unsigned int* indices, int indexCount, glm::vec3 offset = glm::vec3{ 0 });
+    static void setBatchCamera(Camera& camera);
+    static Texture& getWhiteTexture() { return whiteTexture; }
+
+    // Binds the material's textures and parameter block, draw with its shader afterwards.
+    // Switching is skipped while the same material stays current, only changed parameters are uploaded.
+    static void useMaterial(Material* material);
+    static Material* getCurrentMaterial() { return currentMaterial; }
+
+    static VertexFormat getBatchVertexFormat() { return batchVertexFormat; }
+    static void setBatchVertexFormat(VertexFormat format);
+    static void flush(FlushReason reason = FLUSH_REASON_EXPLICIT);
+
+    static void drawTexture(Camera& camera, Texture& texture, glm::vec2 position, glm::vec2 origin, glm::vec2 scale, float rotation, glm::vec2 sourceSize, const UVRect& uv, bool flipH, bool flipV, Shader* shader, float depth = 0);
     static void drawTexture(Camera& camera, Texture& texture, glm::vec2 position, glm::vec2 origin, glm::vec2 scale, float rotation, Rectangle* soruce, bool flipH, bool flipV, Shader* shader, float depth = 0);
     static void drawTexture(Camera& camera, Texture& texture, glm::vec2 position, glm::vec2 origin, glm::vec2 scale, float rotation, Rectangle* soruce, float depth = 0);
     static void drawTexture(Camera& camera, Texture& texture, glm::vec2 position, glm::vec2 origin, glm::vec2 scale, float rotation, float depth = 0);
@@ -0,0 +1,170 @@
+#include "gpu_culling.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <cstddef>
+
+// Layout of DrawArraysIndirectCommand
+struct DrawArguments
+{
+    unsigned int vertexCount;
+    unsigned int instanceCount;
+    unsigned int firstVertex;
+    unsigned int baseInstance;
+};
+
+GpuSpriteSet::GpuSpriteSet(Texture texture, int capacity)
+    : texture(texture)
+{
+    cullShader = Shader::fromComputeSource(ShaderPreprocessor::process("assets/shaders/culling/cull.comp"));
+    drawShader = Shader::fromSource(
+        ShaderPreprocessor::process("assets/shaders/culling/sprite.vert"),
+        ShaderPreprocessor::process("assets/shaders/batch.frag")
+    );
+
+    // Quads are generated from vertex ids, so the VAO has no attributes
+    glGenVertexArrays(1, &VAO);
+
+    glGenBuffers(1, &spriteSSBO);
+    glGenBuffers(1, &visibleSSBO);
+    glGenBuffers(1, &argumentBuffer);
+
+    DrawArguments arguments = { 6, 0, 0, 0 };
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, argumentBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawArguments), &arguments, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    sprites.reserve(capacity);
+    this->capacity = std::max(capacity, 1);
+    allocateBuffers();
+}
+
+void GpuSpriteSet::allocateBuffers()
+{
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, spriteSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(GpuSprite), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(unsigned int), nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void GpuSpriteSet::markDirty(int start, int end)
+{
+    dirtyStart = std::min(dirtyStart, start);
+    dirtyEnd = std::max(dirtyEnd, end);
+}
+
+int GpuSpriteSet::add(const GpuSprite &sprite)
+{
+    sprites.push_back(sprite);
+    markDirty(sprites.size() - 1, sprites.size());
+    return sprites.size() - 1;
+}
+
+void GpuSpriteSet::set(int index, const GpuSprite &sprite)
+{
+    sprites[index] = sprite;
+    markDirty(index, index + 1);
+}
+
+void GpuSpriteSet::remove(int index)
+{
+    sprites[index] = sprites.back();
+    sprites.pop_back();
+    if (index < sprites.size()) markDirty(index, index + 1);
+}
+
+void GpuSpriteSet::clear()
+{
+    sprites.clear();
+    dirtyStart = std::numeric_limits<int>::max();
+    dirtyEnd = 0;
+}
+
+void GpuSpriteSet::reserveBuffers()
+{
+    if (sprites.size() <= capacity) return;
+
+    // Grow geometrically, the whole set has to be uploaded again anyway
+    while (capacity < sprites.size()) capacity *= 2;
+    allocateBuffers();
+    markDirty(0, sprites.size());
+}
+
+void GpuSpriteSet::upload()
+{
+    reserveBuffers();
+
+    dirtyEnd = std::min(dirtyEnd, (int)sprites.size());
+    if (dirtyStart < dirtyEnd) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, spriteSSBO);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, dirtyStart * sizeof(GpuSprite), (dirtyEnd - dirtyStart) * sizeof(GpuSprite), &sprites[dirtyStart]);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        RenderStatistics::get().bytesStreamed += (dirtyEnd - dirtyStart) * sizeof(GpuSprite);
+    }
+
+    dirtyStart = std::numeric_limits<int>::max();
+    dirtyEnd = 0;
+}
+
+void GpuSpriteSet::draw(Camera &camera)
+{
+    if (sprites.empty()) return;
+
+    ObjectDrawer::flush();
+    upload();
+
+    // Cull and compact
+    unsigned int zero = 0;
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, argumentBuffer);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, offsetof(DrawArguments, instanceCount), sizeof(unsigned int), &zero);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GPU_CULLING_SPRITE_BINDING, spriteSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GPU_CULLING_VISIBLE_BINDING, visibleSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GPU_CULLING_ARGUMENTS_BINDING, argumentBuffer);
+
+    Rectangle view = camera.getVisibleBounds();
+    cullShader.use();
+    cullShader.setIntUniform("spriteCount", sprites.size());
+    cullShader.setVec4Uniform("viewBounds", glm::vec4{ view.getLeft(), view.getTop(), view.getRight(), view.getBottom() });
+    glDispatchCompute((sprites.size() + GPU_CULLING_WORKGROUP_SIZE - 1) / GPU_CULLING_WORKGROUP_SIZE, 1, 1);
+
+    // The update bit makes the instance count visible to readVisibleCount()
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    // Draw the compacted list, the instance count never comes back to the CPU
+    drawShader.use();
+    drawShader.setMat4Uniform("projection", camera.getProjectionMatrix());
+    drawShader.setMat4Uniform("view", camera.getViewMatrix());
+    texture.bind();
+
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, argumentBuffer);
+    glDrawArraysIndirect(GL_TRIANGLES, nullptr);
+    // Only the GPU knows how many survived culling, this is the count before it
+    RenderStatistics::get().drawCalls++;
+    RenderStatistics::get().instances += sprites.size();
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    ObjectDrawer::bindVertexArray();
+    ObjectDrawer::resetState();
+}
+
+int GpuSpriteSet::readVisibleCount()
+{
+    DrawArguments arguments;
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, argumentBuffer);
+    glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(DrawArguments), &arguments);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    return arguments.instanceCount;
+}
+
+void GpuSpriteSet::clean()
+{
+    cullShader.clean();
+    drawShader.clean();
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &spriteSSBO);
+    glDeleteBuffers(1, &visibleSSBO);
+    glDeleteBuffers(1, &argumentBuffer);
+}
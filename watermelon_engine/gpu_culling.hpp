@@ -0,0 +1,69 @@
+#pragma once
+#include "gfx.hpp"
+
+#define GPU_CULLING_WORKGROUP_SIZE 256
+#define GPU_CULLING_SPRITE_BINDING 4
+#define GPU_CULLING_VISIBLE_BINDING 5
+#define GPU_CULLING_ARGUMENTS_BINDING 6
+
+// Laid out for std430, keep in sync with assets/shaders/culling/sprite.glsl
+struct GpuSprite
+{
+    glm::vec2 position;
+    glm::vec2 origin;
+    glm::vec2 size;
+    // In radians, unlike the rest of the engine, so the shader doesn't convert it per vertex
+    float rotation;
+    float depth;
+    // uv0 in xy and uv1 in zw, same meaning as UVRect
+    glm::vec4 uv;
+    glm::vec4 color;
+};
+
+// Huge sprite sets that live on the GPU. A compute shader culls them against the camera, compacts the visible ones
+// and writes the instance count of an indirect draw, so the CPU cost per frame doesn't grow with the sprite count.
+// Only changed sprites are uploaded. All sprites share one texture, use an atlas for variety.
+class GpuSpriteSet
+{
+private:
+    Texture texture;
+    std::vector<GpuSprite> sprites;
+
+    Shader cullShader;
+    Shader drawShader;
+    unsigned int VAO;
+
+    unsigned int spriteSSBO;
+    unsigned int visibleSSBO;
+    unsigned int argumentBuffer;
+    int capacity = 0;
+
+    // Range of sprites changed since the last upload
+    int dirtyStart = std::numeric_limits<int>::max();
+    int dirtyEnd = 0;
+
+    void markDirty(int start, int end);
+    void allocateBuffers();
+    void reserveBuffers();
+    void upload();
+public:
+    GpuSpriteSet() = default;
+    GpuSpriteSet(Texture texture, int capacity = 1024);
+
+    inline Texture& getTexture() { return texture; }
+    inline void setTexture(Texture texture) { this->texture = texture; }
+
+    inline int getCount() const { return sprites.size(); }
+    inline const GpuSprite& get(int index) const { return sprites[index]; }
+
+    int add(const GpuSprite& sprite);
+    void set(int index, const GpuSprite& sprite);
+    // Moves the last sprite into the freed slot, so indices of other sprites stay valid except the last one
+    void remove(int index);
+    void clear();
+
+    void draw(Camera& camera);
+    // Waits for the GPU, only meant for debugging and stats
+    int readVisibleCount();
+    void clean();
+};
@@ -0,0 +1,116 @@
+#include "gpu_timer.hpp"
+#include "core.hpp"
+
+std::unordered_map<std::string, GpuTimer> GpuProfiler::timers;
+std::vector<std::string> GpuProfiler::passOrder;
+std::vector<GpuTimer*> GpuProfiler::openPasses;
+bool GpuProfiler::enabled = true;
+
+void GpuTimer::begin()
+{
+    if (!initialized) {
+        glGenQueries(GPU_TIMER_LATENCY * 2, &queries[0][0]);
+        initialized = true;
+    }
+
+    // Pending geometry belongs before the pass whether or not it gets measured
+    ObjectDrawer::flush();
+    readResults();
+
+    // The GPU is more than GPU_TIMER_LATENCY passes behind, skip this one instead of waiting
+    if (pending[queryIndex]) return;
+
+    glQueryCounter(queries[queryIndex][0], GL_TIMESTAMP);
+    measuring = true;
+}
+
+void GpuTimer::end()
+{
+    if (!measuring) return;
+
+    ObjectDrawer::flush();
+    glQueryCounter(queries[queryIndex][1], GL_TIMESTAMP);
+    pending[queryIndex] = true;
+    queryIndex = (queryIndex + 1) % GPU_TIMER_LATENCY;
+    measuring = false;
+}
+
+void GpuTimer::readResults()
+{
+    // Starting at the slot written next goes from the oldest query to the newest
+    for (int i = 0; i < GPU_TIMER_LATENCY; i++) {
+        int slot = (queryIndex + i) % GPU_TIMER_LATENCY;
+        if (!pending[slot]) continue;
+
+        int available = 0;
+        glGetQueryObjectiv(queries[slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) break;
+
+        GLuint64 start = 0, end = 0;
+        glGetQueryObjectui64v(queries[slot][0], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(queries[slot][1], GL_QUERY_RESULT, &end);
+        pending[slot] = false;
+
+        lastTime = (end - start) / 1000000.f;
+        results[resultCount++ % GPU_TIMER_LATENCY] = lastTime;
+        time = time == 0.f ? lastTime : time * (1.f - SMOOTHING) + lastTime * SMOOTHING;
+    }
+}
+
+void GpuTimer::clean()
+{
+    if (!initialized) return;
+
+    glDeleteQueries(GPU_TIMER_LATENCY * 2, &queries[0][0]);
+    for (bool& slot : pending) slot = false;
+    initialized = false;
+    measuring = false;
+}
+
+void GpuProfiler::beginPass(const std::string &name)
+{
+    if (!enabled) return;
+
+    auto timer = timers.find(name);
+    if (timer == timers.end()) {
+        timer = timers.emplace(name, GpuTimer{}).first;
+        passOrder.push_back(name);
+    }
+
+    timer->second.begin();
+    openPasses.push_back(&timer->second);
+}
+
+void GpuProfiler::endPass()
+{
+    if (openPasses.empty()) return;
+
+    openPasses.back()->end();
+    openPasses.pop_back();
+}
+
+float GpuProfiler::getPassTime(const std::string &name)
+{
+    auto timer = timers.find(name);
+    return timer != timers.end() ? timer->second.getTime() : 0.f;
+}
+
+std::vector<GpuPassTime> GpuProfiler::getPassTimes()
+{
+    std::vector<GpuPassTime> passTimes;
+    for (const std::string& name : passOrder) {
+        GpuTimer& timer = timers[name];
+        passTimes.push_back(GpuPassTime{ name, timer.getTime(), timer.getLastTime() });
+    }
+    return passTimes;
+}
+
+void GpuProfiler::clean()
+{
+    for (auto& timer : timers) {
+        timer.second.clean();
+    }
+    timers.clear();
+    passOrder.clear();
+    openPasses.clear();
+}
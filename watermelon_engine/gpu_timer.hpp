@@ -0,0 +1,76 @@
+#pragma once
+#include "gfx.hpp"
+
+// Query pairs per timer, results are picked up as soon as the GPU gets to them but never waited for
+#define GPU_TIMER_LATENCY 4
+
+// Measures GPU time between begin() and end() with timestamp queries, so timers can be nested.
+// Batched geometry is flushed at both ends to land in the pass that queued it.
+class GpuTimer
+{
+private:
+    unsigned int queries[GPU_TIMER_LATENCY][2];
+    bool pending[GPU_TIMER_LATENCY] = {};
+    int queryIndex = 0;
+    bool initialized = false;
+    bool measuring = false;
+
+    // Milliseconds, smoothed and the latest result
+    float time = 0.f;
+    float lastTime = 0.f;
+    // The last GPU_TIMER_LATENCY results in the order they resolved, resultCount counts every result so far
+    float results[GPU_TIMER_LATENCY] = {};
+    unsigned long long resultCount = 0;
+public:
+    GpuTimer() = default;
+
+    inline float getTime() const { return time; }
+    inline float getLastTime() const { return lastTime; }
+    // No more than GPU_TIMER_LATENCY results can resolve between two begin() calls, so reading every
+    // index since the last known count after each pass sees each result exactly once
+    inline unsigned long long getResultCount() const { return resultCount; }
+    inline float getResult(unsigned long long index) const { return results[index % GPU_TIMER_LATENCY]; }
+
+    // Picks up finished queries, begin() does this on its own
+    void readResults();
+
+    void begin();
+    void end();
+    void clean();
+};
+
+struct GpuPassTime
+{
+    std::string name;
+    float time;
+    float lastTime;
+};
+
+// Named timers for render passes, e.g. clear, world, post-process and UI. Passes are listed in the order they first ran.
+class GpuProfiler
+{
+private:
+    static std::unordered_map<std::string, GpuTimer> timers;
+    static std::vector<std::string> passOrder;
+    static std::vector<GpuTimer*> openPasses;
+    static bool enabled;
+public:
+    static bool isEnabled() { return enabled; }
+    static void setEnabled(bool enabled) { GpuProfiler::enabled = enabled; }
+
+    static void beginPass(const std::string& name);
+    static void endPass();
+
+    // Smoothed milliseconds, zero for passes that didn't run yet
+    static float getPassTime(const std::string& name);
+    static std::vector<GpuPassTime> getPassTimes();
+    static void clean();
+};
+
+// Times the enclosing block as a pass
+class GpuScope
+{
+public:
+    GpuScope(const std::string& name) { GpuProfiler::beginPass(name); }
+    ~GpuScope() { GpuProfiler::endPass(); }
+};
@@ -0,0 +1,187 @@
+#include "lighting.hpp"
+#include "gpu_timer.hpp"
+
+LightSystem::LightSystem(float width, float height, int tileSize)
+    : tileSize(tileSize)
+{
+    tileShader = Shader("assets/shaders/lighting/tiles.vert", "assets/shaders/lighting/tiles.frag");
+    compositeShader = Shader("assets/shaders/lighting/composite.vert", "assets/shaders/lighting/composite.frag");
+
+    // Quads are generated from vertex ids, so the VAO has no attributes
+    glGenVertexArrays(1, &VAO);
+
+    glGenBuffers(1, &lightSSBO);
+    glGenBuffers(1, &tileRangeSSBO);
+    glGenBuffers(1, &activeTileSSBO);
+    glGenBuffers(1, &lightIndexSSBO);
+
+    lightMap = RenderTarget(width, height);
+    tilesX = ((int)width + tileSize - 1) / tileSize;
+    tilesY = ((int)height + tileSize - 1) / tileSize;
+}
+
+void LightSystem::resize(float width, float height)
+{
+    lightMap.clean();
+    lightMap = RenderTarget(width, height);
+
+    tilesX = ((int)width + tileSize - 1) / tileSize;
+    tilesY = ((int)height + tileSize - 1) / tileSize;
+}
+
+void LightSystem::binLights(Camera &camera)
+{
+    glm::mat4 view = camera.getViewMatrix();
+    float mapWidth = lightMap.getWidth();
+    float mapHeight = lightMap.getHeight();
+
+    screenLights.clear();
+    lightTileBounds.clear();
+    activeTiles.clear();
+    tileRanges.assign(tilesX * tilesY, glm::uvec2{ 0, 0 });
+
+    // Move lights into framebuffer space (origin at the bottom left) and count lights per tile
+    for (const PointLight& light : lights) {
+        glm::vec4 screenPosition = view * glm::vec4{ light.position, 0.f, 1.f };
+
+        PointLight screenLight = light;
+        screenLight.position = glm::vec2{ screenPosition.x, mapHeight - screenPosition.y };
+        screenLight.radius = light.radius * camera.getZoom();
+
+        float left = screenLight.position.x - screenLight.radius;
+        float right = screenLight.position.x + screenLight.radius;
+        float bottom = screenLight.position.y - screenLight.radius;
+        float top = screenLight.position.y + screenLight.radius;
+        if (right < 0 || left >= mapWidth || top < 0 || bottom >= mapHeight) continue;
+
+        glm::ivec4 bounds{
+            std::max((int)left / tileSize, 0),
+            std::max((int)bottom / tileSize, 0),
+            std::min((int)right / tileSize, tilesX - 1),
+            std::min((int)top / tileSize, tilesY - 1)
+        };
+
+        for (int y = bounds.y; y <= bounds.w; y++) {
+            for (int x = bounds.x; x <= bounds.z; x++) {
+                tileRanges[y * tilesX + x].y++;
+            }
+        }
+
+        screenLights.push_back(screenLight);
+        lightTileBounds.push_back(bounds);
+    }
+
+    // Prefix sum gives every tile its offset in the index list
+    unsigned int offset = 0;
+    for (int i = 0; i < tileRanges.size(); i++) {
+        tileRanges[i].x = offset;
+        offset += tileRanges[i].y;
+
+        if (tileRanges[i].y > 0) activeTiles.push_back(i);
+    }
+
+    lightIndices.resize(offset);
+    tileCursors.resize(tileRanges.size());
+    for (int i = 0; i < tileRanges.size(); i++) {
+        tileCursors[i] = tileRanges[i].x;
+    }
+
+    for (int i = 0; i < screenLights.size(); i++) {
+        const glm::ivec4& bounds = lightTileBounds[i];
+        for (int y = bounds.y; y <= bounds.w; y++) {
+            for (int x = bounds.x; x <= bounds.z; x++) {
+                lightIndices[tileCursors[y * tilesX + x]++] = i;
+            }
+        }
+    }
+}
+
+void LightSystem::render(Camera &camera)
+{
+    if (camera.getWidth() != lightMap.getWidth() || camera.getHeight() != lightMap.getHeight()) {
+        resize(camera.getWidth(), camera.getHeight());
+    }
+
+    binLights(camera);
+
+    GpuScope scope("lighting");
+    ObjectDrawer::resetState();
+    lightMap.use();
+
+    glClearColor(ambient.r, ambient.g, ambient.b, 1.f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    if (!activeTiles.empty()) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, lightSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, screenLights.size() * sizeof(PointLight), screenLights.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileRangeSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, tileRanges.size() * sizeof(glm::uvec2), tileRanges.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, activeTileSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, activeTiles.size() * sizeof(unsigned int), activeTiles.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, lightIndexSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, lightIndices.size() * sizeof(unsigned int), lightIndices.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        RenderStatistics::get().bytesStreamed += screenLights.size() * sizeof(PointLight) + tileRanges.size() * sizeof(glm::uvec2)
+            + (activeTiles.size() + lightIndices.size()) * sizeof(unsigned int);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, lightSSBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, tileRangeSSBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, activeTileSSBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, lightIndexSSBO);
+
+        tileShader.use();
+        tileShader.setIntUniform("tilesX", tilesX);
+        tileShader.setIntUniform("tileSize", tileSize);
+        tileShader.setVec2Uniform("screenSize", glm::vec2{ lightMap.getWidth(), lightMap.getHeight() });
+        tileShader.setVec4Uniform("ambient", ambient.toVec4());
+
+        glDisable(GL_DEPTH_TEST);
+        glBindVertexArray(VAO);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 6, activeTiles.size());
+        RenderStatistics::get().drawCalls++;
+        RenderStatistics::get().instances += activeTiles.size();
+        glEnable(GL_DEPTH_TEST);
+
+        ObjectDrawer::bindVertexArray();
+    }
+
+    lightMap.unuse();
+}
+
+void LightSystem::composite(RenderTarget &scene)
+{
+    GpuScope scope("post-process");
+    ObjectDrawer::resetState();
+
+    compositeShader.use();
+    compositeShader.setIntUniform("scene", 0);
+    compositeShader.setIntUniform("lightMap", 1);
+
+    glActiveTexture(GL_TEXTURE0);
+    scene.getTexture().bind();
+    glActiveTexture(GL_TEXTURE1);
+    lightMap.getTexture().bind();
+    glActiveTexture(GL_TEXTURE0);
+
+    glDisable(GL_DEPTH_TEST);
+    glBindVertexArray(VAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    RenderStatistics::get().drawCalls++;
+    RenderStatistics::get().vertices += 3;
+    glEnable(GL_DEPTH_TEST);
+
+    ObjectDrawer::bindVertexArray();
+}
+
+void LightSystem::clean()
+{
+    lightMap.clean();
+    tileShader.clean();
+    compositeShader.clean();
+
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &lightSSBO);
+    glDeleteBuffers(1, &tileRangeSSBO);
+    glDeleteBuffers(1, &activeTileSSBO);
+    glDeleteBuffers(1, &lightIndexSSBO);
+}
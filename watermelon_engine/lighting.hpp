@@ -0,0 +1,67 @@
+#pragma once
+#include "gfx.hpp"
+
+#define LIGHT_TILE_SIZE 32
+
+struct PointLight
+{
+    glm::vec2 position;
+    float radius;
+    float intensity;
+    glm::vec4 color;
+};
+
+class LightSystem
+{
+private:
+    std::vector<PointLight> lights;
+    Color ambient = Color{ 0.f, 0.f, 0.f };
+
+    RenderTarget lightMap;
+    Shader tileShader;
+    Shader compositeShader;
+    unsigned int VAO;
+
+    // Buffers that are read by the tile shader
+    unsigned int lightSSBO;
+    unsigned int tileRangeSSBO;
+    unsigned int activeTileSSBO;
+    unsigned int lightIndexSSBO;
+
+    int tileSize;
+    int tilesX;
+    int tilesY;
+
+    // Binning results, rebuilt every frame
+    std::vector<PointLight> screenLights;
+    std::vector<glm::ivec4> lightTileBounds;
+    std::vector<unsigned int> tileCursors;
+    std::vector<glm::uvec2> tileRanges;
+    std::vector<unsigned int> activeTiles;
+    std::vector<unsigned int> lightIndices;
+
+    void resize(float width, float height);
+    void binLights(Camera& camera);
+public:
+    LightSystem() = default;
+    LightSystem(float width, float height, int tileSize = LIGHT_TILE_SIZE);
+
+    inline std::vector<PointLight>& getLights() { return lights; }
+    inline int addLight(const PointLight& light) {
+        lights.push_back(light);
+        return lights.size() - 1;
+    }
+    inline void removeLight(int index) { lights.erase(lights.begin() + index); }
+    inline void clearLights() { lights.clear(); }
+
+    inline Color getAmbient() const { return ambient; }
+    inline void setAmbient(const Color& ambient) { this->ambient = ambient; }
+
+    inline RenderTarget& getLightMap() { return lightMap; }
+
+    // Accumulates all lights seen by the camera into the light map in a single instanced pass over lit tiles
+    void render(Camera& camera);
+    // Multiplies the scene by the light map and draws the result to the currently bound framebuffer
+    void composite(RenderTarget& scene);
+    void clean();
+};
@@ -0,0 +1,131 @@
+#include "material.hpp"
+#include "core.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+unsigned int Material::nextId = 1;
+std::vector<unsigned short> Material::freeIds;
+
+Material::Material(Shader *shader, size_t parameterSize)
+    : shader(shader)
+{
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+    }
+    else if (nextId <= std::numeric_limits<unsigned short>::max()) {
+        id = nextId++;
+    }
+    else {
+        SDL_Log("All %u material ids are in use, clean materials that aren't needed anymore!", (unsigned int)std::numeric_limits<unsigned short>::max());
+        this->shader = nullptr;
+        return;
+    }
+
+    if (parameterSize > 0) {
+        parameters.resize(parameterSize, 0);
+        glGenBuffers(1, &UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferData(GL_UNIFORM_BUFFER, parameterSize, parameters.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+}
+
+Material::Material(Material &&other) noexcept
+{
+    *this = std::move(other);
+}
+
+Material &Material::operator=(Material &&other) noexcept
+{
+    if (this == &other) return *this;
+
+    clean();
+    id = std::exchange(other.id, 0);
+    shader = std::exchange(other.shader, nullptr);
+    for (int i = 0; i < MATERIAL_MAX_TEXTURES; i++) {
+        textures[i] = std::move(other.textures[i]);
+    }
+    textureCount = std::exchange(other.textureCount, 0);
+    samplersDirty = true;
+    parameters = std::move(other.parameters);
+    other.parameters.clear();
+    UBO = std::exchange(other.UBO, 0);
+    parametersDirty = std::exchange(other.parametersDirty, false);
+    return *this;
+}
+
+void Material::setTexture(int slot, Texture texture, const std::string &sampler)
+{
+    if (slot < 0 || slot >= MATERIAL_MAX_TEXTURES) {
+        SDL_Log("Material texture slot %d is out of range!", slot);
+        return;
+    }
+
+    textures[slot] = TextureSlot{ texture, sampler };
+    textureCount = std::max(textureCount, slot + 1);
+    samplersDirty = true;
+}
+
+void Material::setParameters(const void *data, size_t size, size_t offset)
+{
+    if (offset + size > parameters.size()) {
+        SDL_Log("Material parameters of %zu bytes at %zu don't fit into a block of %zu bytes!", size, offset, parameters.size());
+        return;
+    }
+
+    if (std::memcmp(parameters.data() + offset, data, size) == 0) return;
+
+    std::memcpy(parameters.data() + offset, data, size);
+    parametersDirty = true;
+}
+
+void Material::upload()
+{
+    if (!parametersDirty) return;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, parameters.size(), parameters.data());
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    RenderStatistics::get().bytesStreamed += parameters.size();
+    parametersDirty = false;
+}
+
+void Material::bind()
+{
+    if (!shader) return;
+
+    shader->use();
+
+    // Sampler units are program state, so they only have to be set again when slots change
+    if (samplersDirty) {
+        for (int i = 0; i < textureCount; i++) {
+            if (!textures[i].sampler.empty()) shader->setIntUniform(textures[i].sampler, i + 1);
+        }
+        samplersDirty = false;
+    }
+
+    for (int i = 0; i < textureCount; i++) {
+        if (!textures[i].texture.getId()) continue;
+
+        glActiveTexture(GL_TEXTURE1 + i);
+        textures[i].texture.bind();
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    if (UBO) {
+        upload();
+        glBindBufferBase(GL_UNIFORM_BUFFER, MATERIAL_UNIFORM_BINDING, UBO);
+    }
+}
+
+void Material::clean()
+{
+    if (UBO) glDeleteBuffers(1, &UBO);
+    UBO = 0;
+
+    if (id) freeIds.push_back(id);
+    id = 0;
+}
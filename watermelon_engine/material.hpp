@@ -0,0 +1,68 @@
+#pragma once
+#include "gfx.hpp"
+#include <cstring>
+
+// Uniform block binding shared by all materials, declare it in shaders as
+// layout (std140, binding = 0) uniform MaterialParameters { ... };
+#define MATERIAL_UNIFORM_BINDING 0
+// Material textures go to units 1 and up, unit 0 stays for the sprite texture
+#define MATERIAL_MAX_TEXTURES 4
+
+// Shader, extra textures and a parameter block that many sprites share.
+// Parameters are kept on CPU and uploaded to the uniform buffer once when changed, not per draw.
+// Sprites and draw lists point to materials, so keep them at a fixed address. Materials own their id and
+// uniform buffer, so they can be moved but not copied.
+class Material
+{
+private:
+    struct TextureSlot
+    {
+        Texture texture;
+        std::string sampler;
+    };
+
+    // Zero is reserved for "no material" in sort keys
+    unsigned short id = 0;
+    Shader* shader = nullptr;
+
+    TextureSlot textures[MATERIAL_MAX_TEXTURES];
+    int textureCount = 0;
+    bool samplersDirty = true;
+
+    std::vector<unsigned char> parameters;
+    unsigned int UBO = 0;
+    bool parametersDirty = false;
+
+    // Wider than the ids, so running out can be told apart from wrapping to zero
+    static unsigned int nextId;
+    static std::vector<unsigned short> freeIds;
+public:
+    Material() = default;
+    // parameterSize is the std140 size of the shader's MaterialParameters block.
+    // With every id taken the material is left empty, its id stays zero
+    Material(Shader* shader, size_t parameterSize = 0);
+    Material(const Material&) = delete;
+    Material& operator=(const Material&) = delete;
+    Material(Material&& other) noexcept;
+    // Cleans the material moved into first
+    Material& operator=(Material&& other) noexcept;
+
+    inline unsigned short getId() const { return id; }
+    inline Shader* getShader() { return shader; }
+
+    inline int getTextureCount() const { return textureCount; }
+    void setTexture(int slot, Texture texture, const std::string& sampler);
+
+    inline size_t getParameterSize() const { return parameters.size(); }
+    inline const unsigned char* getParameters() const { return parameters.data(); }
+    void setParameters(const void* data, size_t size, size_t offset = 0);
+    // Offset has to follow std140 rules of the block, e.g. vec4 and vec3 start at multiples of 16
+    template<typename T>
+    void setParameter(size_t offset, const T& value) { setParameters(&value, sizeof(T), offset); }
+
+    // Uploads parameters if they changed, only does something when the block is dirty
+    void upload();
+    // Makes the material current: program, textures and uniform buffer
+    void bind();
+    void clean();
+};
@@ -0,0 +1,141 @@
+#include "overdraw.hpp"
+#include "core.hpp"
+#include "utils.hpp"
+
+OverdrawMeter::OverdrawMeter(float width, float height)
+{
+    reduceShader = Shader::fromComputeSource(ShaderPreprocessor::process("assets/shaders/overdraw/reduce.comp"));
+    heatMapShader = Shader("assets/shaders/lighting/composite.vert", "assets/shaders/overdraw/heat_map.frag");
+
+    // Fullscreen triangle is generated from vertex ids
+    glGenVertexArrays(1, &VAO);
+
+    glGenBuffers(OVERDRAW_READBACK_DELAY + 1, resultSSBOs);
+    for (unsigned int buffer : resultSSBOs) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(unsigned int) * 3, nullptr, GL_DYNAMIC_READ);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    target = RenderTarget(width, height, true);
+}
+
+void OverdrawMeter::resize(float width, float height)
+{
+    target.clean();
+    target = RenderTarget(width, height, true);
+}
+
+void OverdrawMeter::begin()
+{
+    if (target.getWidth() != Engine::getScreenWidth() || target.getHeight() != Engine::getScreenHeight()) {
+        resize(Engine::getScreenWidth(), Engine::getScreenHeight());
+    }
+
+    target.use();
+    glClearColor(0.f, 0.f, 0.f, 1.f);
+    glClearStencil(0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+    // Every fragment that gets shaded bumps its pixel, 255 is the ceiling
+    glEnable(GL_STENCIL_TEST);
+    glStencilMask(0xFF);
+    glStencilFunc(GL_ALWAYS, 0, 0xFF);
+    glStencilOp(GL_KEEP, GL_KEEP, GL_INCR);
+
+    active = true;
+}
+
+void OverdrawMeter::end()
+{
+    if (!active) return;
+    active = false;
+
+    ObjectDrawer::flush();
+    glDisable(GL_STENCIL_TEST);
+    target.unuse();
+
+    reduce();
+    readResults();
+
+    if (!showHeatMap) {
+        Camera screen(Engine::getScreenWidth(), Engine::getScreenHeight());
+        glDisable(GL_DEPTH_TEST);
+        target.draw(screen, glm::vec2{ 0 }, glm::vec2{ 1 }, glm::vec2{ 0 });
+        ObjectDrawer::flush();
+        glEnable(GL_DEPTH_TEST);
+        return;
+    }
+
+    ObjectDrawer::resetState();
+
+    heatMapShader.use();
+    heatMapShader.setIntUniform("overdraw", 0);
+    heatMapShader.setFloatUniform("heatScale", OVERDRAW_HEAT_MAP_SCALE);
+    glBindTexture(GL_TEXTURE_2D, target.getStencilTexture());
+
+    glDisable(GL_DEPTH_TEST);
+    glBindVertexArray(VAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glEnable(GL_DEPTH_TEST);
+
+    ObjectDrawer::bindVertexArray();
+    ObjectDrawer::resetState();
+}
+
+void OverdrawMeter::reduce()
+{
+    unsigned int buffer = resultSSBOs[frameIndex];
+    unsigned int zeros[3] = { 0, 0, 0 };
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zeros), zeros);
+
+    reduceShader.use();
+    reduceShader.setIntUniform("overdraw", 0);
+    glBindTexture(GL_TEXTURE_2D, target.getStencilTexture());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glDispatchCompute(((int)target.getWidth() + 15) / 16, ((int)target.getHeight() + 15) / 16, 1);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    if (fences[frameIndex]) glDeleteSync((GLsync)fences[frameIndex]);
+    fences[frameIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    frameIndex = (frameIndex + 1) % (OVERDRAW_READBACK_DELAY + 1);
+    ObjectDrawer::resetState();
+}
+
+void OverdrawMeter::readResults()
+{
+    // The slot written next is the oldest one in flight
+    GLsync fence = (GLsync)fences[frameIndex];
+    if (!fence || glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) return;
+
+    glDeleteSync(fence);
+    fences[frameIndex] = nullptr;
+
+    unsigned int results[3];
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, resultSSBOs[frameIndex]);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(results), results);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    float pixels = target.getWidth() * target.getHeight();
+    stats.average = results[0] / pixels;
+    stats.max = results[1];
+    stats.coveredAverage = results[2] ? (float)results[0] / results[2] : 0.f;
+    stats.coverage = results[2] / pixels;
+}
+
+void OverdrawMeter::clean()
+{
+    target.clean();
+    reduceShader.clean();
+    heatMapShader.clean();
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(OVERDRAW_READBACK_DELAY + 1, resultSSBOs);
+
+    for (void*& fence : fences) {
+        if (fence) glDeleteSync((GLsync)fence);
+        fence = nullptr;
+    }
+}
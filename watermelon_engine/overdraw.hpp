@@ -0,0 +1,56 @@
+#pragma once
+#include "gfx.hpp"
+
+// Results are read this many frames late so measuring doesn't stall on the GPU
+#define OVERDRAW_READBACK_DELAY 2
+// Count that maps to the hottest color of the heat map
+#define OVERDRAW_HEAT_MAP_SCALE 8
+
+struct OverdrawStats
+{
+    // Fragments per pixel of the whole screen
+    float average;
+    // Fragments per pixel that was drawn at least once
+    float coveredAverage;
+    int max;
+    float coverage;
+};
+
+// Debug mode that counts how many fragments land on every pixel. Everything drawn between begin() and end()
+// goes into an offscreen target whose stencil is incremented by every fragment that passes the depth test,
+// a compute shader then sums it up. end() shows either the scene or a heat map of the counts.
+class OverdrawMeter
+{
+private:
+    RenderTarget target;
+    Shader reduceShader;
+    Shader heatMapShader;
+    unsigned int VAO;
+
+    // Sum, maximum and covered pixel count per frame in flight
+    unsigned int resultSSBOs[OVERDRAW_READBACK_DELAY + 1];
+    void* fences[OVERDRAW_READBACK_DELAY + 1] = {};
+    int frameIndex = 0;
+
+    OverdrawStats stats = {};
+    bool showHeatMap = true;
+    bool active = false;
+
+    void resize(float width, float height);
+    void reduce();
+    void readResults();
+public:
+    OverdrawMeter() = default;
+    OverdrawMeter(float width, float height);
+
+    inline bool isHeatMapShown() const { return showHeatMap; }
+    inline void setHeatMapShown(bool showHeatMap) { this->showHeatMap = showHeatMap; }
+
+    inline const OverdrawStats& getStats() const { return stats; }
+    inline RenderTarget& getTarget() { return target; }
+
+    void begin();
+    // Draws the heat map or the scene to the previously bound framebuffer
+    void end();
+    void clean();
+};
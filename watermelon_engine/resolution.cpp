@@ -0,0 +1,143 @@
+#include "resolution.hpp"
+#include "core.hpp"
+
+void DynamicResolution::begin(Color clearColor)
+{
+    int width = std::max(1, (int)std::round(Engine::getScreenWidth() * scale));
+    int height = std::max(1, (int)std::round(Engine::getScreenHeight() * scale));
+
+    currentTarget = pool.acquire(width, height);
+    currentTarget->use();
+    ObjectDrawer::clearBackground(clearColor);
+
+    GpuProfiler::beginPass("world");
+    timer.begin();
+}
+
+void DynamicResolution::end()
+{
+    if (!currentTarget) return;
+
+    timer.end();
+    GpuProfiler::endPass();
+
+    currentTarget->unuse();
+
+    // Upscale to the window with a camera that maps one unit to one pixel
+    Camera screen(Engine::getScreenWidth(), Engine::getScreenHeight());
+    glm::vec2 upscale = glm::vec2{ Engine::getScreenWidth() / currentTarget->getWidth(), Engine::getScreenHeight() / currentTarget->getHeight() };
+    glDisable(GL_DEPTH_TEST);
+    currentTarget->draw(screen, glm::vec2{ 0 }, upscale, glm::vec2{ 0 });
+    glEnable(GL_DEPTH_TEST);
+
+    pool.release(currentTarget);
+    currentTarget = nullptr;
+
+    adjustScale();
+}
+
+void DynamicResolution::adjustScale()
+{
+    float gpuTime = timer.getTime();
+
+    framesSinceChange++;
+    if (gpuTime == 0.f || framesSinceChange < cooldownFrames) return;
+
+    // Fill cost grows with the pixel count, which is the square of the scale
+    float wantedScale = scale * std::sqrt(targetGpuTime / gpuTime);
+    if (gpuTime < targetGpuTime && gpuTime > targetGpuTime * .85f) return;
+
+    float newScale = glm::clamp(std::round(wantedScale / scaleStep) * scaleStep, minScale, maxScale);
+    if (newScale != scale) {
+        scale = newScale;
+        framesSinceChange = 0;
+    }
+}
+
+void DynamicResolution::clean()
+{
+    pool.clean();
+    timer.clean();
+}
+
+void PixelPerfectView::setResolution(int width, int height)
+{
+    if (this->width == width && this->height == height) return;
+
+    this->width = width;
+    this->height = height;
+    clean();
+}
+
+void PixelPerfectView::updateViewport()
+{
+    int screenWidth = Engine::getScreenWidth();
+    int screenHeight = Engine::getScreenHeight();
+
+    upscale = std::max(1, std::min(screenWidth / width, screenHeight / height));
+    viewportOrigin = glm::vec2{ (float)((screenWidth - width * upscale) / 2), (float)((screenHeight - height * upscale) / 2) };
+}
+
+void PixelPerfectView::begin(Camera &camera)
+{
+    if (!hasTarget) {
+        target = RenderTarget(width + 2, height + 2);
+        hasTarget = true;
+    }
+
+    updateViewport();
+
+    this->camera = &camera;
+    savedPosition = camera.getPosition();
+    savedOrigin = camera.getOrigin();
+    savedWidth = camera.getWidth();
+    savedHeight = camera.getHeight();
+
+    // Snap the translation down to whole pixels, the rest is applied when upscaling
+    glm::vec2 translation = -camera.getPosition();
+    glm::vec2 snapped = glm::floor(translation);
+    subpixelOffset = subpixelSmoothing ? translation - snapped : glm::vec2{ 0 };
+
+    camera.setPosition(-snapped / camera.getZoom());
+    camera.setOrigin(savedOrigin + glm::vec2{ 1 });
+    camera.setWidth(width + 2);
+    camera.setHeight(height + 2);
+
+    target.use();
+}
+
+void PixelPerfectView::end()
+{
+    if (!camera) return;
+
+    target.unuse();
+
+    camera->setPosition(savedPosition / camera->getZoom());
+    camera->setOrigin(savedOrigin);
+    camera->setWidth(savedWidth);
+    camera->setHeight(savedHeight);
+    camera = nullptr;
+
+    glClearColor(barColor.r, barColor.g, barColor.b, barColor.a);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // Scissor hides the extra border pixels that would otherwise spill into the bars
+    Camera screen(Engine::getScreenWidth(), Engine::getScreenHeight());
+    glm::vec2 position = viewportOrigin + (subpixelOffset - glm::vec2{ 1 }) * (float)upscale;
+
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(viewportOrigin.x, Engine::getScreenHeight() - viewportOrigin.y - height * upscale, width * upscale, height * upscale);
+    glDisable(GL_DEPTH_TEST);
+    target.draw(screen, position, glm::vec2{ (float)upscale }, glm::vec2{ 0 });
+    ObjectDrawer::flush();
+    glEnable(GL_DEPTH_TEST);
+    glDisable(GL_SCISSOR_TEST);
+}
+
+void PixelPerfectView::clean()
+{
+    if (!hasTarget) return;
+
+    target.clean();
+    hasTarget = false;
+}
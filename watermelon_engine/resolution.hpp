@@ -0,0 +1,113 @@
+#pragma once
+#include "gfx.hpp"
+#include "gpu_timer.hpp"
+
+// Renders the world pass into a scaled target and picks the scale from measured GPU time.
+// Everything drawn between begin() and end() is upscaled to the window, UI drawn after end() stays native.
+class DynamicResolution
+{
+private:
+    float minScale = .5f;
+    float maxScale = 1.f;
+    float scaleStep = .05f;
+    float scale = 1.f;
+
+    // Milliseconds of GPU time the world pass may take
+    float targetGpuTime = 12.f;
+    int cooldownFrames = 30;
+    int framesSinceChange = 0;
+
+    RenderTargetPool pool;
+    RenderTarget* currentTarget = nullptr;
+
+    // Results are read a few frames later so the CPU never waits for the GPU
+    GpuTimer timer;
+
+    void adjustScale();
+public:
+    DynamicResolution() = default;
+    DynamicResolution(float minScale, float maxScale, float targetGpuTime)
+        : minScale(minScale), maxScale(maxScale), scale(maxScale), targetGpuTime(targetGpuTime) {}
+
+    inline float getScale() const { return scale; }
+    inline void setScale(float scale) { this->scale = glm::clamp(scale, minScale, maxScale); }
+
+    inline float getMinScale() const { return minScale; }
+    inline float getMaxScale() const { return maxScale; }
+    inline void setScaleBounds(float minScale, float maxScale) {
+        this->minScale = minScale;
+        this->maxScale = maxScale;
+        setScale(scale);
+    }
+
+    inline float getScaleStep() const { return scaleStep; }
+    inline void setScaleStep(float scaleStep) { this->scaleStep = scaleStep; }
+
+    inline float getTargetGpuTime() const { return targetGpuTime; }
+    inline void setTargetGpuTime(float targetGpuTime) { this->targetGpuTime = targetGpuTime; }
+
+    inline int getCooldownFrames() const { return cooldownFrames; }
+    inline void setCooldownFrames(int cooldownFrames) { this->cooldownFrames = cooldownFrames; }
+
+    inline float getGpuTime() const { return timer.getTime(); }
+    inline RenderTarget* getCurrentTarget() { return currentTarget; }
+
+    // Pooled targets still hold an older frame, so the target is cleared with the color
+    void begin(Color clearColor = Color{ 0.f, 0.f, 0.f });
+    void end();
+    void clean();
+};
+
+
+// Renders the world at a fixed low resolution, e.g. 320x180 for pixel art, and upscales it by the largest whole
+// factor that fits the window with bars around. The camera is snapped to whole pixels for the world pass,
+// with subpixel smoothing the leftover fraction moves the upscaled image instead, so slow pans stay smooth.
+class PixelPerfectView
+{
+private:
+    int width = 320;
+    int height = 180;
+    // One extra pixel on every side keeps edges filled while the image is shifted by a fraction
+    RenderTarget target;
+    bool hasTarget = false;
+
+    bool subpixelSmoothing = true;
+    Color barColor = Color{ 0.f, 0.f, 0.f };
+
+    int upscale = 1;
+    glm::vec2 viewportOrigin = glm::vec2{ 0 };
+    glm::vec2 subpixelOffset = glm::vec2{ 0 };
+
+    // Camera state restored by end()
+    Camera* camera = nullptr;
+    glm::vec2 savedPosition;
+    glm::vec2 savedOrigin;
+    float savedWidth;
+    float savedHeight;
+
+    void updateViewport();
+public:
+    PixelPerfectView() = default;
+    PixelPerfectView(int width, int height) : width(width), height(height) {}
+
+    inline int getWidth() const { return width; }
+    inline int getHeight() const { return height; }
+    void setResolution(int width, int height);
+
+    inline bool isSubpixelSmoothing() const { return subpixelSmoothing; }
+    inline void setSubpixelSmoothing(bool subpixelSmoothing) { this->subpixelSmoothing = subpixelSmoothing; }
+
+    inline Color getBarColor() const { return barColor; }
+    inline void setBarColor(Color barColor) { this->barColor = barColor; }
+
+    inline int getUpscale() const { return upscale; }
+    // Area of the window the view covers
+    inline Rectangle getViewport() const { return Rectangle{ viewportOrigin.x, viewportOrigin.y, (float)width * upscale, (float)height * upscale }; }
+    // Maps window coordinates, e.g. the mouse, to low resolution ones
+    inline glm::vec2 windowToView(glm::vec2 windowPosition) const { return (windowPosition - viewportOrigin) / (float)upscale; }
+
+    // The camera is adjusted to the low resolution until end(), clear the background after begin() as usual
+    void begin(Camera& camera);
+    void end();
+    void clean();
+};
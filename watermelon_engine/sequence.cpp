@@ -69,6 +69,7 @@ AnimationPlayer::AnimationPlayer(std::string animFile)
 				frameToAdd->regionIndex = regionIndex;
 				frameToAdd->delay = delay;
 				frameToAdd->source = atlas.getRegion(regionIndex);
+				frameToAdd->uv = atlas.getRegionUV(regionIndex);
 
 				frames.push_back(frameToAdd);
 			}
@@ -127,6 +128,7 @@ AnimationPlayer::AnimationPlayer(std::string animFile)
 				frame->regionIndex = frameDataIndex;
 				frame->delay = delay * 0.001f;
 				frame->source = source;
+				frame->uv = UVRect(source, texture.getWidth(), texture.getHeight());
 
 				frames.push_back(frame);
 
@@ -183,6 +185,20 @@ void AnimationPlayer::draw(Camera& camera, glm::vec2 position, glm::vec2 scale,
 		return;
 	}
 	
-	Rectangle source = getCurrentFrame()->source;
-	ObjectDrawer::drawTexture(camera, texture, position, origin, scale, rotation, &source, flipX, flipY, shader, layerDepth);
+	AnimationFrame* frame = getCurrentFrame();
+	glm::vec2 sourceSize = glm::vec2{ frame->source.width, frame->source.height };
+	ObjectDrawer::drawTexture(camera, texture, position, origin, scale, rotation, sourceSize, frame->uv, flipX, flipY, shader, layerDepth);
 }
+
+
+void AnimationPlayer::record(DrawList& drawList, glm::vec2 position, glm::vec2 scale, glm::vec2 origin, float rotation, Shader* shader, float layerDepth, bool flipX, bool flipY)
+{
+	if (getCurrentAnimation() == nullptr || getCurrentFrame() == nullptr) {
+		drawList.addTexture(texture, position, origin, scale, rotation, nullptr, flipX, flipY, shader, layerDepth);
+		return;
+	}
+
+	AnimationFrame* frame = getCurrentFrame();
+	glm::vec2 sourceSize = glm::vec2{ frame->source.width, frame->source.height };
+	drawList.addTexture(texture, position, origin, scale, rotation, sourceSize, frame->uv, flipX, flipY, shader, layerDepth);
+}
\ No newline at end of file
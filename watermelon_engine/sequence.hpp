@@ -4,6 +4,7 @@
 #include <unordered_map>
 #include <nlohmann/json.hpp>
 #include "utils.hpp"
+#include "draw_list.hpp"
 
 enum AnimationType
 {
@@ -16,6 +17,7 @@ struct AnimationFrame
 	int regionIndex;
 	float delay;
 	Rectangle source;
+	UVRect uv;
 };
 
 class Animation
@@ -67,6 +69,7 @@ public:
 	void stop();
 	void update(float delta);
 	void draw(Camera& camera, glm::vec2 position, glm::vec2 scale, glm::vec2 origin, float rotation, Shader* shader, float layerDepth = 0, bool flipX = false, bool flipY = false);
+	void record(DrawList& drawList, glm::vec2 position, glm::vec2 scale, glm::vec2 origin, float rotation, Shader* shader, float layerDepth = 0, bool flipX = false, bool flipY = false);
 
 private:
 	std::string animFile;
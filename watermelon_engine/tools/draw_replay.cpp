@@ -0,0 +1,103 @@
+#include "watermelon_engine/core.hpp"
+#include <SDL3/SDL_main.h>
+#include <algorithm>
+#include <cstdlib>
+
+// Replays a draw stream as fast as the renderer allows and reports how long the frames took.
+// Usage: DrawReplay <stream> [passes]
+
+static double percentile(std::vector<double> times, double fraction)
+{
+    if (times.empty()) return 0.0;
+
+    std::sort(times.begin(), times.end());
+    return times[std::min(times.size() - 1, (size_t)(fraction * times.size()))];
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        SDL_Log("Usage: DrawReplay <stream> [passes]");
+        return 1;
+    }
+
+    std::string path = argv[1];
+    int passes = argc > 2 ? std::max(1, std::atoi(argv[2])) : 10;
+
+    DrawStreamHeader header;
+    if (!DrawStreamPlayer::readHeader(path, header)) return 1;
+
+    // No pacing and no visible window, frames go to a target instead of the screen
+    Engine::setFramePacing(FRAME_PACING_UNCAPPED);
+    Engine::initialize("Draw replay", header.screenWidth, header.screenHeight, false);
+    if (!Engine::getGLContext()) return 1;
+    SDL_HideWindow(Engine::getWindow());
+    ObjectDrawer::initialize();
+
+    DrawStreamPlayer player;
+    if (!player.load(path) || player.getFrameCount() == 0) {
+        ObjectDrawer::clean();
+        Engine::close();
+        return 1;
+    }
+
+    RenderTarget target(player.getScreenWidth(), player.getScreenHeight());
+    GpuTimer gpuTimer;
+
+    std::vector<double> cpuTimes;
+    std::vector<double> gpuTimes;
+    unsigned long long frameIndex = 0;
+    unsigned long long gpuResults = 0;
+
+    // Results arrive a few frames late and frames are skipped while the GPU is behind, so take every new one once
+    auto collectGpuTimes = [&]() {
+        for (; gpuResults < gpuTimer.getResultCount(); gpuResults++) gpuTimes.push_back(gpuTimer.getResult(gpuResults));
+    };
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int pass = 0; pass < passes; pass++) {
+        for (int frame = 0; frame < player.getFrameCount(); frame++) {
+            RenderStatistics::beginFrame(frameIndex++);
+            ObjectDrawer::bindVertexArray();
+            ObjectDrawer::resetState();
+
+            target.use();
+            gpuTimer.begin();
+
+            Uint64 frameStart = SDL_GetPerformanceCounter();
+            player.replayFrame(frame);
+            ObjectDrawer::flush(FLUSH_REASON_FRAME);
+            cpuTimes.push_back((double)(SDL_GetPerformanceCounter() - frameStart) * 1000.0 / SDL_GetPerformanceFrequency());
+
+            gpuTimer.end();
+            target.unuse();
+            collectGpuTimes();
+        }
+    }
+    glFinish();
+    double totalTime = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+    gpuTimer.readResults();
+    collectGpuTimes();
+
+    // The final frame never rotated into the history
+    const RenderStats& stats = RenderStatistics::get();
+    double gpuAverage = 0.0;
+    for (double time : gpuTimes) gpuAverage += time;
+    if (!gpuTimes.empty()) gpuAverage /= gpuTimes.size();
+
+    SDL_Log("Replayed %d frames %d times (%d frames) in %.2f ms, %.3f ms per frame",
+        player.getFrameCount(), passes, (int)cpuTimes.size(), totalTime, totalTime / cpuTimes.size());
+    SDL_Log("CPU submit: median %.3f ms, p95 %.3f ms, max %.3f ms",
+        percentile(cpuTimes, .5), percentile(cpuTimes, .95), percentile(cpuTimes, 1.));
+    SDL_Log("GPU: average %.3f ms, p95 %.3f ms over %d measured frames", gpuAverage, percentile(gpuTimes, .95), (int)gpuTimes.size());
+    SDL_Log("Last frame: %d draw calls, %d batches, %lld vertices, %zu bytes streamed",
+        stats.drawCalls, stats.batches, stats.vertices, stats.bytesStreamed);
+
+    gpuTimer.clean();
+    target.clean();
+    player.clean();
+    GpuProfiler::clean();
+    ObjectDrawer::clean();
+    Engine::close();
+    return 0;
+}
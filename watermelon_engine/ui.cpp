@@ -0,0 +1,495 @@
+#include "ui.hpp"
+#include "core.hpp"
+#include <algorithm>
+#include <cstdio>
+
+UIStyle UI::style;
+
+std::unordered_map<unsigned long long, UIWindow> UI::windows;
+std::vector<UIWindow*> UI::frameWindows;
+UIWindow* UI::currentWindow = nullptr;
+unsigned long long UI::frame = 0;
+
+glm::vec2 UI::mousePosition = glm::vec2{ 0.f };
+bool UI::mouseDown = false;
+bool UI::mousePressed = false;
+bool UI::mouseReleased = false;
+unsigned long long UI::hotId = 0;
+unsigned long long UI::activeId = 0;
+
+int UI::rebuiltWindows = 0;
+
+// FNV-1a, ops are hashed field by field so struct padding never leaks in
+static void hashBytes(unsigned long long& hash, const void* data, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+}
+
+template<typename T>
+static void hashValue(unsigned long long& hash, const T& value)
+{
+    hashBytes(hash, &value, sizeof(T));
+}
+
+static bool containsPoint(const Rectangle& rectangle, glm::vec2 point)
+{
+    return point.x >= rectangle.getLeft() && point.x < rectangle.getRight() && point.y >= rectangle.getTop() && point.y < rectangle.getBottom();
+}
+
+static bool sameRectangle(const Rectangle& a, const Rectangle& b)
+{
+    return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+}
+
+static Rectangle intersect(const Rectangle& a, const Rectangle& b)
+{
+    float left = std::max(a.getLeft(), b.getLeft());
+    float top = std::max(a.getTop(), b.getTop());
+    float right = std::min(a.getRight(), b.getRight());
+    float bottom = std::min(a.getBottom(), b.getBottom());
+    return Rectangle{ left, top, std::max(0.f, right - left), std::max(0.f, bottom - top) };
+}
+
+void UI::beginFrame()
+{
+    // A release is seen by the widgets for one frame before the active widget lets go
+    if (mouseReleased || !mouseDown) activeId = 0;
+    hotId = 0;
+
+    float x, y;
+    bool down = SDL_GetMouseState(&x, &y) & SDL_BUTTON_LMASK;
+
+    // Mouse comes in window pixels, widgets live in screen pixels
+    int windowWidth, windowHeight;
+    SDL_GetWindowSize(Engine::getWindow(), &windowWidth, &windowHeight);
+    if (windowWidth > 0 && windowHeight > 0) {
+        x *= (float)Engine::getScreenWidth() / windowWidth;
+        y *= (float)Engine::getScreenHeight() / windowHeight;
+    }
+
+    mousePosition = glm::vec2{ x, y };
+    mousePressed = down && !mouseDown;
+    mouseReleased = !down && mouseDown;
+    mouseDown = down;
+
+    frame++;
+    frameWindows.clear();
+}
+
+unsigned long long UI::makeId(const std::string &label)
+{
+    unsigned long long hash = 14695981039346656037ull;
+    if (currentWindow) hashValue(hash, currentWindow->id);
+    hashBytes(hash, label.data(), label.size());
+    return hash;
+}
+
+void UI::addOp(const UIOp &op)
+{
+    if (!currentWindow) {
+        SDL_Log("UI drawing outside of beginWindow() and endWindow() is ignored");
+        return;
+    }
+
+    unsigned long long& hash = currentWindow->hash;
+    hashValue(hash, op.type);
+    hashValue(hash, op.rectangle.x);
+    hashValue(hash, op.rectangle.y);
+    hashValue(hash, op.rectangle.width);
+    hashValue(hash, op.rectangle.height);
+    hashValue(hash, op.color);
+    hashValue(hash, op.scale);
+    if (op.type == UI_OP_IMAGE) {
+        hashValue(hash, op.texture.getId());
+        hashValue(hash, op.uv.uv0);
+        hashValue(hash, op.uv.uv1);
+    }
+    if (op.type == UI_OP_TEXT) {
+        hashValue(hash, op.text.size());
+        hashBytes(hash, op.text.data(), op.text.size());
+    }
+
+    currentWindow->ops.push_back(op);
+}
+
+void UI::beginWindow(const std::string &title, Rectangle rectangle)
+{
+    if (currentWindow) {
+        SDL_Log("UI window \"%s\" started inside another window, windows can't be nested", title.c_str());
+        return;
+    }
+
+    unsigned long long id = makeId(title);
+    UIWindow& window = windows[id];
+    if (window.lastUsedFrame == frame) {
+        SDL_Log("UI window \"%s\" submitted twice in one frame", title.c_str());
+    }
+
+    window.id = id;
+    window.rectangle = rectangle;
+    window.ops.clear();
+    window.hash = 14695981039346656037ull;
+    window.clipDepth = 0;
+    window.lastUsedFrame = frame;
+    currentWindow = &window;
+    frameWindows.push_back(&window);
+
+    float titleHeight = style.widgetHeight;
+    Rectangle titleBar = Rectangle{ rectangle.x, rectangle.y, rectangle.width, titleHeight };
+    drawRectangle(rectangle, style.windowColor);
+    drawRectangle(titleBar, style.titleColor);
+    drawOutline(rectangle, style.borderColor);
+
+    float textHeight = PIXEL_FONT_GLYPH_HEIGHT * style.textScale;
+    drawText(glm::vec2{ rectangle.x + style.padding, rectangle.y + std::floor((titleHeight - textHeight) / 2.f) }, title, style.textColor, style.textScale);
+
+    // Widgets never spill over the border or into the title bar
+    pushClip(Rectangle{ rectangle.x + 1.f, rectangle.y + titleHeight, rectangle.width - 2.f, rectangle.height - titleHeight - 1.f });
+    window.cursor = glm::vec2{ rectangle.x + style.padding, rectangle.y + titleHeight + style.padding };
+}
+
+void UI::endWindow()
+{
+    if (!currentWindow) return;
+
+    while (currentWindow->clipDepth > 0) popClip();
+    currentWindow = nullptr;
+}
+
+Rectangle UI::nextWidget(float height)
+{
+    if (!currentWindow) return Rectangle{};
+
+    Rectangle widget = Rectangle{ currentWindow->cursor.x, currentWindow->cursor.y, currentWindow->rectangle.width - style.padding * 2.f, height };
+    currentWindow->cursor.y += height + style.spacing;
+    return widget;
+}
+
+bool UI::interact(unsigned long long id, const Rectangle &rectangle)
+{
+    // Only the visible part of a widget reacts, e.g. not what is scrolled out of a clip
+    Rectangle clip = currentWindow->clipDepth > 0 ? currentWindow->clips[currentWindow->clipDepth - 1] : currentWindow->rectangle;
+    bool inside = containsPoint(rectangle, mousePosition) && containsPoint(clip, mousePosition);
+    if (inside) hotId = id;
+    if (inside && mousePressed) activeId = id;
+    return inside && mouseReleased && activeId == id;
+}
+
+void UI::label(const std::string &text)
+{
+    if (!currentWindow) return;
+
+    glm::vec2 size = PixelFont::measure(text, style.textScale);
+    Rectangle widget = nextWidget(std::max(size.y, style.widgetHeight));
+    drawText(glm::vec2{ widget.x, widget.y + std::floor((widget.height - size.y) / 2.f) }, text, style.textColor, style.textScale);
+}
+
+bool UI::button(const std::string &text)
+{
+    if (!currentWindow) return false;
+
+    unsigned long long id = makeId(text);
+    Rectangle widget = nextWidget(style.widgetHeight);
+    bool clicked = interact(id, widget);
+
+    glm::vec4 color = activeId == id ? style.activeColor : hotId == id ? style.hotColor : style.widgetColor;
+    drawRectangle(widget, color);
+
+    glm::vec2 size = PixelFont::measure(text, style.textScale);
+    drawText(glm::floor(glm::vec2{ widget.x + (widget.width - size.x) / 2.f, widget.y + (widget.height - size.y) / 2.f }), text, style.textColor, style.textScale);
+    return clicked;
+}
+
+bool UI::checkbox(const std::string &text, bool &value)
+{
+    if (!currentWindow) return false;
+
+    unsigned long long id = makeId(text);
+    Rectangle widget = nextWidget(style.widgetHeight);
+    bool clicked = interact(id, widget);
+    if (clicked) value = !value;
+
+    Rectangle box = Rectangle{ widget.x, widget.y, widget.height, widget.height };
+    drawRectangle(box, activeId == id ? style.activeColor : hotId == id ? style.hotColor : style.widgetColor);
+    if (value) {
+        float inset = std::floor(widget.height / 4.f);
+        drawRectangle(Rectangle{ box.x + inset, box.y + inset, box.width - inset * 2.f, box.height - inset * 2.f }, style.accentColor);
+    }
+
+    glm::vec2 size = PixelFont::measure(text, style.textScale);
+    drawText(glm::vec2{ box.getRight() + style.padding, widget.y + std::floor((widget.height - size.y) / 2.f) }, text, style.textColor, style.textScale);
+    return clicked;
+}
+
+bool UI::slider(const std::string &text, float &value, float min, float max)
+{
+    if (!currentWindow) return false;
+
+    unsigned long long id = makeId(text);
+    Rectangle widget = nextWidget(style.widgetHeight);
+    interact(id, widget);
+
+    // Keeps following the mouse after it leaves the widget until released
+    bool changed = false;
+    if (activeId == id && mouseDown && widget.width > 0.f && max > min) {
+        float fraction = std::clamp((mousePosition.x - widget.x) / widget.width, 0.f, 1.f);
+        float newValue = min + fraction * (max - min);
+        changed = newValue != value;
+        value = newValue;
+    }
+
+    float fraction = max > min ? std::clamp((value - min) / (max - min), 0.f, 1.f) : 0.f;
+    drawRectangle(widget, activeId == id ? style.activeColor : hotId == id ? style.hotColor : style.widgetColor);
+    drawRectangle(Rectangle{ widget.x, widget.y, std::round(widget.width * fraction), widget.height }, style.accentColor);
+
+    char valueText[32];
+    std::snprintf(valueText, sizeof(valueText), ": %.2f", value);
+    std::string caption = text + valueText;
+    glm::vec2 size = PixelFont::measure(caption, style.textScale);
+    drawText(glm::floor(glm::vec2{ widget.x + (widget.width - size.x) / 2.f, widget.y + (widget.height - size.y) / 2.f }), caption, style.textColor, style.textScale);
+    return changed;
+}
+
+void UI::progressBar(float fraction)
+{
+    if (!currentWindow) return;
+
+    Rectangle widget = nextWidget(style.widgetHeight / 2.f);
+    drawRectangle(widget, style.widgetColor);
+    drawRectangle(Rectangle{ widget.x, widget.y, std::round(widget.width * std::clamp(fraction, 0.f, 1.f)), widget.height }, style.accentColor);
+}
+
+void UI::image(Texture &texture, glm::vec2 size, const UVRect &uv)
+{
+    if (!currentWindow) return;
+
+    Rectangle widget = nextWidget(size.y);
+    drawImage(texture, Rectangle{ widget.x, widget.y, size.x, size.y }, uv);
+}
+
+void UI::separator()
+{
+    if (!currentWindow) return;
+
+    Rectangle widget = nextWidget(1.f);
+    drawRectangle(widget, style.borderColor);
+}
+
+void UI::drawRectangle(Rectangle rectangle, glm::vec4 color)
+{
+    addOp(UIOp{ UI_OP_RECTANGLE, rectangle, color, Texture{}, UVRect{}, std::string{}, 0.f });
+}
+
+void UI::drawOutline(Rectangle rectangle, glm::vec4 color, float thickness)
+{
+    addOp(UIOp{ UI_OP_OUTLINE, rectangle, color, Texture{}, UVRect{}, std::string{}, thickness });
+}
+
+void UI::drawImage(Texture &texture, Rectangle rectangle, const UVRect &uv, glm::vec4 tint)
+{
+    addOp(UIOp{ UI_OP_IMAGE, rectangle, tint, texture, uv, std::string{}, 0.f });
+}
+
+void UI::drawText(glm::vec2 position, const std::string &text, glm::vec4 color, float scale)
+{
+    if (text.empty()) return;
+
+    addOp(UIOp{ UI_OP_TEXT, Rectangle{ position.x, position.y, 0.f, 0.f }, color, Texture{}, UVRect{}, text, scale });
+}
+
+void UI::pushClip(Rectangle rectangle)
+{
+    if (!currentWindow) return;
+    if (currentWindow->clipDepth >= UI_MAX_CLIP_DEPTH) {
+        SDL_Log("UI clip stack is full, more than %d nested clips", UI_MAX_CLIP_DEPTH);
+        return;
+    }
+
+    int depth = currentWindow->clipDepth;
+    Rectangle parent = depth > 0 ? currentWindow->clips[depth - 1] : currentWindow->rectangle;
+    currentWindow->clips[depth] = intersect(parent, rectangle);
+    currentWindow->clipDepth++;
+    addOp(UIOp{ UI_OP_PUSH_CLIP, rectangle, glm::vec4{ 0.f }, Texture{}, UVRect{}, std::string{}, 0.f });
+}
+
+void UI::popClip()
+{
+    if (!currentWindow || currentWindow->clipDepth == 0) return;
+
+    currentWindow->clipDepth--;
+    addOp(UIOp{ UI_OP_POP_CLIP, Rectangle{}, glm::vec4{ 0.f }, Texture{}, UVRect{}, std::string{}, 0.f });
+}
+
+bool UI::isMouseOverUI()
+{
+    for (const auto& [id, window] : windows) {
+        if (window.lastUsedFrame + 1 >= frame && containsPoint(window.rectangle, mousePosition)) return true;
+    }
+    return false;
+}
+
+void UI::build(UIWindow &window)
+{
+    window.vertices.clear();
+    window.indices.clear();
+    window.commands.clear();
+
+    std::vector<Rectangle> clips = { window.rectangle };
+    Texture& white = ObjectDrawer::getWhiteTexture();
+
+    // Appends to the last command when texture and clip match, so a window is usually one or two draws
+    auto addQuad = [&](Texture& texture, glm::vec2 topLeft, glm::vec2 bottomRight, glm::vec2 uv0, glm::vec2 uv1, const glm::vec4& color) {
+        const Rectangle& clip = clips.back();
+        if (clip.width <= 0.f || clip.height <= 0.f) return;
+
+        if (window.commands.empty()
+            || window.commands.back().texture.getId() != texture.getId()
+            || !sameRectangle(window.commands.back().clip, clip)
+            || window.commands.back().vertexCount + 4 > BATCH_MAX_VERTICES) {
+            window.commands.push_back(UIDrawCommand{ texture, clip, (int)window.vertices.size(), 0, (int)window.indices.size(), 0 });
+        }
+
+        UIDrawCommand& command = window.commands.back();
+        unsigned int first = command.vertexCount;
+        window.vertices.push_back(BatchVertex{ glm::vec3{ topLeft, 0.f }, glm::vec2{ uv0.x, uv1.y }, color });
+        window.vertices.push_back(BatchVertex{ glm::vec3{ bottomRight.x, topLeft.y, 0.f }, uv1, color });
+        window.vertices.push_back(BatchVertex{ glm::vec3{ bottomRight, 0.f }, glm::vec2{ uv1.x, uv0.y }, color });
+        window.vertices.push_back(BatchVertex{ glm::vec3{ topLeft.x, bottomRight.y, 0.f }, uv0, color });
+
+        unsigned int quad[6] = { first, first + 1, first + 3, first + 1, first + 2, first + 3 };
+        window.indices.insert(window.indices.end(), quad, quad + 6);
+        command.vertexCount += 4;
+        command.indexCount += 6;
+    };
+    auto addSolid = [&](float x, float y, float width, float height, const glm::vec4& color) {
+        addQuad(white, glm::vec2{ x, y }, glm::vec2{ x + width, y + height }, glm::vec2{ .5f }, glm::vec2{ .5f }, color);
+    };
+
+    for (UIOp& op : window.ops) {
+        const Rectangle& r = op.rectangle;
+        switch (op.type) {
+        case UI_OP_RECTANGLE:
+            addSolid(r.x, r.y, r.width, r.height, op.color);
+            break;
+        case UI_OP_OUTLINE:
+            addSolid(r.x, r.y, r.width, op.scale, op.color);
+            addSolid(r.x, r.getBottom() - op.scale, r.width, op.scale, op.color);
+            addSolid(r.x, r.y + op.scale, op.scale, r.height - op.scale * 2.f, op.color);
+            addSolid(r.getRight() - op.scale, r.y + op.scale, op.scale, r.height - op.scale * 2.f, op.color);
+            break;
+        case UI_OP_IMAGE:
+            addQuad(op.texture, glm::vec2{ r.x, r.y }, glm::vec2{ r.getRight(), r.getBottom() }, op.uv.uv0, op.uv.uv1, op.color);
+            break;
+        case UI_OP_TEXT: {
+            // Runs of lit pixels in a glyph row become one quad
+            glm::vec2 cursor = glm::vec2{ r.x, r.y };
+            for (char character : op.text) {
+                if (character == '\n') {
+                    cursor = glm::vec2{ r.x, cursor.y + (PIXEL_FONT_GLYPH_HEIGHT + 1) * op.scale };
+                    continue;
+                }
+
+                unsigned short glyph = PixelFont::getGlyph(character);
+                for (int row = 0; row < PIXEL_FONT_GLYPH_HEIGHT; row++) {
+                    int column = 0;
+                    while (column < PIXEL_FONT_GLYPH_WIDTH) {
+                        if (!PixelFont::isPixelSet(glyph, column, row)) {
+                            column++;
+                            continue;
+                        }
+                        int start = column;
+                        while (column < PIXEL_FONT_GLYPH_WIDTH && PixelFont::isPixelSet(glyph, column, row)) column++;
+                        addSolid(cursor.x + start * op.scale, cursor.y + row * op.scale, (column - start) * op.scale, op.scale, op.color);
+                    }
+                }
+                cursor.x += (PIXEL_FONT_GLYPH_WIDTH + 1) * op.scale;
+            }
+            break;
+        }
+        case UI_OP_PUSH_CLIP:
+            clips.push_back(intersect(clips.back(), r));
+            break;
+        case UI_OP_POP_CLIP:
+            if (clips.size() > 1) clips.pop_back();
+            break;
+        }
+    }
+
+    window.geometryHash = window.hash;
+    window.hasGeometry = true;
+}
+
+void UI::render(UIWindow &window, Camera &camera, Rectangle &currentClip)
+{
+    // Scissor works in framebuffer pixels with Y up, the viewport tells how screen pixels map to them
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glm::vec2 scale = glm::vec2{ viewport[2] / camera.getWidth(), viewport[3] / camera.getHeight() };
+
+    for (UIDrawCommand& command : window.commands) {
+        if (!sameRectangle(command.clip, currentClip)) {
+            ObjectDrawer::flush(FLUSH_REASON_STATE);
+            currentClip = command.clip;
+            glScissor(
+                viewport[0] + (GLint)std::floor(currentClip.x * scale.x),
+                viewport[1] + (GLint)std::floor((camera.getHeight() - currentClip.getBottom()) * scale.y),
+                (GLsizei)std::ceil(currentClip.width * scale.x),
+                (GLsizei)std::ceil(currentClip.height * scale.y)
+            );
+        }
+
+        ObjectDrawer::submitBatch(camera, command.texture, &window.vertices[command.vertexOffset], command.vertexCount, &window.indices[command.indexOffset], command.indexCount);
+    }
+}
+
+void UI::render()
+{
+    if (currentWindow) {
+        SDL_Log("UI window was not ended before render()");
+        endWindow();
+    }
+
+    rebuiltWindows = 0;
+    for (UIWindow* window : frameWindows) {
+        if (window->hasGeometry && window->geometryHash == window->hash) continue;
+        build(*window);
+        rebuiltWindows++;
+    }
+
+    if (!frameWindows.empty()) {
+        GpuScope scope("ui");
+        Camera screen(Engine::getScreenWidth(), Engine::getScreenHeight());
+
+        // UI goes over everything drawn so far, later windows over earlier ones
+        ObjectDrawer::flush(FLUSH_REASON_STATE);
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_SCISSOR_TEST);
+
+        Rectangle currentClip = Rectangle{ -1.f, -1.f, 0.f, 0.f };
+        for (UIWindow* window : frameWindows) {
+            render(*window, screen, currentClip);
+        }
+
+        ObjectDrawer::flush(FLUSH_REASON_STATE);
+        glDisable(GL_SCISSOR_TEST);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    frameWindows.clear();
+
+    // Drop geometry of windows that stopped showing up
+    std::erase_if(windows, [](const auto& entry) { return entry.second.lastUsedFrame + UI_WINDOW_EXPIRE_FRAMES < frame; });
+}
+
+void UI::clean()
+{
+    windows.clear();
+    frameWindows.clear();
+    currentWindow = nullptr;
+    hotId = 0;
+    activeId = 0;
+}
@@ -0,0 +1,145 @@
+#pragma once
+#include "gfx.hpp"
+#include <unordered_map>
+
+// Nested pushClip() levels inside one window
+#define UI_MAX_CLIP_DEPTH 16
+// Windows not submitted for this many frames lose their cached geometry
+#define UI_WINDOW_EXPIRE_FRAMES 120
+
+enum UIOpType
+{
+    UI_OP_RECTANGLE,
+    UI_OP_OUTLINE,
+    UI_OP_IMAGE,
+    UI_OP_TEXT,
+    UI_OP_PUSH_CLIP,
+    UI_OP_POP_CLIP
+};
+
+// What a widget asked for, cheap to record and hash. Turned into vertices only when a window changed.
+struct UIOp
+{
+    UIOpType type;
+    Rectangle rectangle;
+    glm::vec4 color;
+    Texture texture;
+    UVRect uv;
+    std::string text;
+    float scale;
+};
+
+// A run of indices sharing one texture and one scissor rectangle, indices are relative to vertexOffset
+struct UIDrawCommand
+{
+    Texture texture;
+    Rectangle clip;
+    int vertexOffset;
+    int vertexCount;
+    int indexOffset;
+    int indexCount;
+};
+
+struct UIWindow
+{
+    unsigned long long id;
+    Rectangle rectangle;
+    glm::vec2 cursor;
+
+    std::vector<UIOp> ops;
+    unsigned long long hash;
+    int clipDepth;
+    // Clips in effect while widgets run, already intersected with their parents
+    Rectangle clips[UI_MAX_CLIP_DEPTH];
+
+    // Geometry built from ops with the hash it was built for
+    unsigned long long geometryHash = 0;
+    bool hasGeometry = false;
+    std::vector<BatchVertex> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<UIDrawCommand> commands;
+
+    unsigned long long lastUsedFrame = 0;
+};
+
+struct UIStyle
+{
+    glm::vec4 windowColor = glm::vec4{ .12f, .12f, .14f, .92f };
+    glm::vec4 titleColor = glm::vec4{ .2f, .2f, .26f, 1.f };
+    glm::vec4 widgetColor = glm::vec4{ .26f, .26f, .32f, 1.f };
+    glm::vec4 hotColor = glm::vec4{ .34f, .34f, .44f, 1.f };
+    glm::vec4 activeColor = glm::vec4{ .44f, .44f, .6f, 1.f };
+    glm::vec4 accentColor = glm::vec4{ .9f, .55f, .2f, 1.f };
+    glm::vec4 textColor = glm::vec4{ .95f, .95f, .95f, 1.f };
+    glm::vec4 borderColor = glm::vec4{ 0.f, 0.f, 0.f, .6f };
+    float textScale = 2.f;
+    float padding = 6.f;
+    float spacing = 4.f;
+    float widgetHeight = 22.f;
+};
+
+// Immediate mode UI in screen pixels. Widgets are called every frame between beginFrame() and render(),
+// each window records ops and a hash of them, and the vertex/index stream is only rebuilt for windows whose hash changed.
+// Output is a list of draw commands merged by texture and clip, drawn with one scissor change per clip.
+// render() draws right away instead of recording into a FrameSnapshot, so it needs Game::run() without the render thread.
+class UI
+{
+private:
+    static UIStyle style;
+
+    static std::unordered_map<unsigned long long, UIWindow> windows;
+    static std::vector<UIWindow*> frameWindows;
+    static UIWindow* currentWindow;
+    static unsigned long long frame;
+
+    static glm::vec2 mousePosition;
+    static bool mouseDown;
+    static bool mousePressed;
+    static bool mouseReleased;
+    static unsigned long long hotId;
+    static unsigned long long activeId;
+
+    static int rebuiltWindows;
+
+    static unsigned long long makeId(const std::string& label);
+    static void addOp(const UIOp& op);
+    static Rectangle nextWidget(float height);
+    // Hover and press handling shared by the widgets, returns true on release over the widget
+    static bool interact(unsigned long long id, const Rectangle& rectangle);
+
+    static void build(UIWindow& window);
+    static void render(UIWindow& window, Camera& camera, Rectangle& currentClip);
+public:
+    static UIStyle& getStyle() { return style; }
+
+    // Reads the mouse, call once per frame before any widget
+    static void beginFrame();
+    // Draws every window submitted this frame on top of what is already there
+    static void render();
+    static void clean();
+
+    static void beginWindow(const std::string& title, Rectangle rectangle);
+    static void endWindow();
+
+    static void label(const std::string& text);
+    static bool button(const std::string& text);
+    static bool checkbox(const std::string& text, bool& value);
+    static bool slider(const std::string& text, float& value, float min, float max);
+    static void progressBar(float fraction);
+    static void image(Texture& texture, glm::vec2 size, const UVRect& uv = UVRect{});
+    static void separator();
+
+    // Free drawing inside the current window, positions are in screen pixels
+    static void drawRectangle(Rectangle rectangle, glm::vec4 color);
+    static void drawOutline(Rectangle rectangle, glm::vec4 color, float thickness = 1.f);
+    static void drawImage(Texture& texture, Rectangle rectangle, const UVRect& uv = UVRect{}, glm::vec4 tint = glm::vec4{ 1.f });
+    static void drawText(glm::vec2 position, const std::string& text, glm::vec4 color, float scale);
+    // Clips are intersected with the parent clip, windows clip to their own rectangle
+    static void pushClip(Rectangle rectangle);
+    static void popClip();
+
+    static bool isMouseOverUI();
+    static int getWindowCount() { return windows.size(); }
+    // Windows whose geometry had to be rebuilt in the last render()
+    static int getRebuiltWindowCount() { return rebuiltWindows; }
+};
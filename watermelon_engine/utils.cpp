@@ -1,4 +1,8 @@
 #include "utils.hpp"
+#include "core.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
 
 float normalizeAxis(float axis, float maxValue)
 {
@@ -6,17 +10,176 @@ float normalizeAxis(float axis, float maxValue)
 }
 
 
-std::unordered_map<std::string, Texture> AssetManager::cachedTextures;
+std::unordered_map<std::string, AssetManager::CachedTexture> AssetManager::cachedTextures;
+std::unordered_map<unsigned int, std::string> AssetManager::textureKeys;
+std::recursive_mutex AssetManager::textureMutex;
+std::atomic<unsigned long long> AssetManager::textureFrame = 0;
+std::atomic<unsigned long long> AssetManager::textureUseFrames[TEXTURE_USE_SLOTS] = {};
 std::unordered_map<std::string, Shader> AssetManager::cachedShaders;
+std::unordered_map<std::string, Shader> AssetManager::cachedShaderVariants;
+
+size_t AssetManager::textureBudget = 0;
+size_t AssetManager::textureUsage = 0;
+size_t AssetManager::peakTextureUsage = 0;
+unsigned long long AssetManager::textureEvictions = 0;
+unsigned long long AssetManager::textureReloads = 0;
+
+// RGBA with a full mipmap chain
+static size_t getTextureSize(const Texture& texture)
+{
+    return (size_t)texture.getWidth() * (size_t)texture.getHeight() * 4 * 4 / 3;
+}
 
 Texture &AssetManager::loadTexture(std::string path)
 {
-    if (!cachedTextures.contains(path)) {
-        Texture texture(("assets/sprites/" + path).c_str());
-        cachedTextures[path] = texture;
+    std::lock_guard<std::recursive_mutex> lock(textureMutex);
+
+    auto cached = cachedTextures.find(path);
+    if (cached != cachedTextures.end()) {
+        // Counts as a use, so an evicted texture comes back with the next frame
+        markTextureUsed(cached->second.texture);
+        return cached->second.texture;
+    }
+
+    Texture texture(("assets/sprites/" + path).c_str());
+
+    CachedTexture& entry = cachedTextures[path];
+    entry.texture = texture;
+    entry.size = getTextureSize(texture);
+    entry.references = 0;
+    entry.resident = true;
+    entry.evictedFrame = 0;
+    textureKeys[texture.getId()] = path;
+    markTextureUsed(texture);
+
+    textureUsage += entry.size;
+    peakTextureUsage = std::max(peakTextureUsage, textureUsage);
+
+    return entry.texture;
+}
+
+void AssetManager::retainTexture(const std::string &path)
+{
+    std::lock_guard<std::recursive_mutex> lock(textureMutex);
+
+    loadTexture(path);
+    cachedTextures[path].references++;
+}
+
+void AssetManager::releaseTexture(const std::string &path)
+{
+    std::lock_guard<std::recursive_mutex> lock(textureMutex);
+
+    auto cached = cachedTextures.find(path);
+    if (cached != cachedTextures.end() && cached->second.references > 0) cached->second.references--;
+}
+
+void AssetManager::markTextureUsed(const Texture &texture)
+{
+    textureUseFrames[texture.getId() % TEXTURE_USE_SLOTS].store(textureFrame.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+unsigned long long AssetManager::getLastUsedFrame(const Texture &texture)
+{
+    return textureUseFrames[texture.getId() % TEXTURE_USE_SLOTS].load(std::memory_order_relaxed);
+}
+
+std::string AssetManager::getTextureKey(const Texture &texture)
+{
+    std::lock_guard<std::recursive_mutex> lock(textureMutex);
+
+    auto key = textureKeys.find(texture.getId());
+    return key != textureKeys.end() ? key->second : std::string{};
+}
+
+void AssetManager::setTextureBudget(size_t bytes)
+{
+    std::lock_guard<std::recursive_mutex> lock(textureMutex);
+
+    textureBudget = bytes;
+}
+
+void AssetManager::updateTextures(unsigned long long frame)
+{
+    textureFrame.store(frame, std::memory_order_relaxed);
+
+    std::lock_guard<std::recursive_mutex> lock(textureMutex);
+
+    for (auto& cached : cachedTextures) {
+        CachedTexture& entry = cached.second;
+        if (!entry.resident && getLastUsedFrame(entry.texture) >= entry.evictedFrame) restoreTexture(cached.first, entry);
+    }
+
+    trimTextures();
+}
+
+void AssetManager::trimTextures()
+{
+    if (textureBudget == 0) return;
+
+    unsigned long long frame = textureFrame.load(std::memory_order_relaxed);
+
+    while (textureUsage > textureBudget) {
+        // Least recently used texture that nobody retains and that wasn't drawn lately
+        CachedTexture* oldest = nullptr;
+        unsigned long long oldestFrame = 0;
+
+        for (auto& cached : cachedTextures) {
+            CachedTexture& entry = cached.second;
+            unsigned long long lastUsedFrame = getLastUsedFrame(entry.texture);
+            if (!entry.resident || entry.references > 0 || lastUsedFrame + TEXTURE_EVICTION_FRAME_DELAY > frame) continue;
+
+            if (!oldest || lastUsedFrame < oldestFrame) {
+                oldest = &entry;
+                oldestFrame = lastUsedFrame;
+            }
+        }
+
+        if (!oldest) {
+            SDL_Log("Texture budget of %zu bytes is exceeded, nothing can be evicted", textureBudget);
+            return;
+        }
+
+        evictTexture(*oldest);
+    }
+}
+
+void AssetManager::evictTexture(CachedTexture &entry)
+{
+    // The name stays allocated, so Texture copies held by sprites, draw lists or materials never point at someone else's texture
+    entry.texture.releasePixels();
+    entry.resident = false;
+    entry.evictedFrame = textureFrame.load(std::memory_order_relaxed);
+    textureUsage -= entry.size;
+    textureEvictions++;
+}
+
+void AssetManager::restoreTexture(const std::string &path, CachedTexture &entry)
+{
+    entry.texture.reload(("assets/sprites/" + path).c_str());
+    entry.resident = true;
+    textureUsage += entry.size;
+    peakTextureUsage = std::max(peakTextureUsage, textureUsage);
+    textureReloads++;
+}
+
+TextureCacheStats AssetManager::getTextureStats()
+{
+    std::lock_guard<std::recursive_mutex> lock(textureMutex);
+
+    int residentCount = 0;
+    for (const auto& cached : cachedTextures) {
+        if (cached.second.resident) residentCount++;
     }
-    
-    return cachedTextures[path];
+
+    return TextureCacheStats{
+        textureBudget,
+        textureUsage,
+        peakTextureUsage,
+        residentCount,
+        textureEvictions,
+        textureReloads
+    };
 }
 
 Shader &AssetManager::loadShader(std::string vertFilePath, std::string fragFilePath)
@@ -51,15 +214,141 @@ Shader &AssetManager::loadShader(std::string filePath, ShaderLoadType loadType)
     return cachedShaders[filePath];
 }
 
+Shader &AssetManager::loadShaderVariant(const std::string &vertFilePath, const std::string &fragFilePath, std::vector<std::string> defines)
+{
+    std::sort(defines.begin(), defines.end());
+    defines.erase(std::unique(defines.begin(), defines.end()), defines.end());
+
+    std::string variantKey = vertFilePath + ";" + fragFilePath;
+    for (const std::string& define : defines) {
+        variantKey += ";" + define;
+    }
+
+    auto cached = cachedShaderVariants.find(variantKey);
+    if (cached != cachedShaderVariants.end()) {
+        return cached->second;
+    }
+
+    Shader shader = Shader::fromSource(
+        ShaderPreprocessor::process("assets/shaders/" + vertFilePath, defines),
+        ShaderPreprocessor::process("assets/shaders/" + fragFilePath, defines)
+    );
+    return cachedShaderVariants[variantKey] = shader;
+}
+
+std::string AssetManager::getShaderKey(const Shader &shader)
+{
+    for (const auto& [key, cached] : cachedShaders) {
+        if (cached == shader) return key;
+    }
+    return std::string{};
+}
+
+void AssetManager::warmShaderVariants(const std::string &vertFilePath, const std::string &fragFilePath, const std::vector<std::vector<std::string>> &defineSets)
+{
+    for (const std::vector<std::string>& defines : defineSets) {
+        loadShaderVariant(vertFilePath, fragFilePath, defines);
+    }
+}
+
 void AssetManager::cleanAll()
 {
+    std::lock_guard<std::recursive_mutex> lock(textureMutex);
+
     for (auto& texture : cachedTextures) {
-        texture.second.clean();
+        texture.second.texture.clean();
     }
     cachedTextures.clear();
+    textureKeys.clear();
+    textureUsage = 0;
 
     for (auto& shader : cachedShaders) {
         shader.second.clean();
     }
     cachedShaders.clear();
+
+    for (auto& shader : cachedShaderVariants) {
+        shader.second.clean();
+    }
+    cachedShaderVariants.clear();
+}
+
+bool ShaderPreprocessor::expand(const std::string &path, std::string &output, std::unordered_set<std::string> &included, int depth)
+{
+    if (depth > SHADER_INCLUDE_MAX_DEPTH) {
+        SDL_Log("Shader includes are nested too deep in %s", path.c_str());
+        return false;
+    }
+
+    std::string normalPath = std::filesystem::path(path).lexically_normal().generic_string();
+    if (!included.insert(normalPath).second) {
+        return true;
+    }
+
+    std::ifstream file(normalPath);
+    if (!file.is_open()) {
+        SDL_Log("Failed to open shader file %s", normalPath.c_str());
+        return false;
+    }
+
+    std::filesystem::path directory = std::filesystem::path(normalPath).parent_path();
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line.compare(start, 8, "#include") != 0) {
+            output += line;
+            output += '\n';
+            continue;
+        }
+
+        size_t open = line.find('"', start);
+        size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+        if (close == std::string::npos) {
+            SDL_Log("Malformed #include in %s:%d", normalPath.c_str(), lineNumber);
+            return false;
+        }
+
+        std::string includePath = (directory / line.substr(open + 1, close - open - 1)).generic_string();
+        if (!expand(includePath, output, included, depth + 1)) {
+            return false;
+        }
+        // Keeps line numbers in compile errors pointing at this file
+        output += "#line " + std::to_string(lineNumber + 1) + "\n";
+    }
+
+    return true;
+}
+
+std::string ShaderPreprocessor::process(const std::string &path, const std::vector<std::string> &defines)
+{
+    std::string source;
+    std::unordered_set<std::string> included;
+    if (!expand(path, source, included, 0)) {
+        return "";
+    }
+
+    std::string defineBlock;
+    for (const std::string& define : defines) {
+        defineBlock += "#define " + define + "\n";
+    }
+    if (defineBlock.empty()) {
+        return source;
+    }
+
+    // #version has to stay the first statement, so defines go right after it
+    size_t version = source.find("#version");
+    size_t insertAt = version == std::string::npos ? 0 : source.find('\n', version);
+    if (insertAt == std::string::npos) {
+        source += '\n';
+        insertAt = source.size();
+    } else if (version != std::string::npos) {
+        insertAt++;
+    }
+
+    int versionLine = (int)std::count(source.begin(), source.begin() + insertAt, '\n');
+    source.insert(insertAt, defineBlock + "#line " + std::to_string(versionLine + 1) + "\n");
+    return source;
 }
@@ -1,21 +1,107 @@
 #pragma once
 #include "gfx.hpp"
 #include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+#include <atomic>
+#include <vector>
+
+// Frames a texture has to stay unused before it can be evicted
+#define TEXTURE_EVICTION_FRAME_DELAY 2
+// Slots for the frame each texture was last bound in, indexed by GL name. Names sharing a slot only keep each other resident longer
+#define TEXTURE_USE_SLOTS 4096
+// Guards against include chains that never end
+#define SHADER_INCLUDE_MAX_DEPTH 16
 
 enum ShaderLoadType {
     SHADER_LOAD_TYPE_VERT,
     SHADER_LOAD_TYPE_FRAG
 };
 
+struct TextureCacheStats
+{
+    size_t budget;
+    size_t usage;
+    size_t peakUsage;
+    int residentCount;
+    unsigned long long evictions;
+    unsigned long long reloads;
+};
+
+// Expands #include "file" (relative to the including file, every file only once)
+// and puts the defines ("NAME" or "NAME VALUE") right after #version
+class ShaderPreprocessor
+{
+private:
+    static bool expand(const std::string& path, std::string& output, std::unordered_set<std::string>& included, int depth);
+public:
+    static std::string process(const std::string& path, const std::vector<std::string>& defines = {});
+};
+
 class AssetManager
 {
 private:
-    static std::unordered_map<std::string, Texture> cachedTextures;
+    struct CachedTexture
+    {
+        Texture texture;
+        size_t size;
+        int references;
+        // Evicted textures keep their GL name with the pixels dropped, a bind after evictedFrame loads them again
+        bool resident;
+        unsigned long long evictedFrame;
+    };
+
+    static std::unordered_map<std::string, CachedTexture> cachedTextures;
+    static std::unordered_map<unsigned int, std::string> textureKeys;
+    // Guards the cache, binds never take it
+    static std::recursive_mutex textureMutex;
+    static std::atomic<unsigned long long> textureFrame;
+    static std::atomic<unsigned long long> textureUseFrames[TEXTURE_USE_SLOTS];
     static std::unordered_map<std::string, Shader> cachedShaders;
+    // Keyed by "vert;frag;define;..." with the defines sorted
+    static std::unordered_map<std::string, Shader> cachedShaderVariants;
+
+    // Zero means there is no budget
+    static size_t textureBudget;
+    static size_t textureUsage;
+    static size_t peakTextureUsage;
+    static unsigned long long textureEvictions;
+    static unsigned long long textureReloads;
+
+    static unsigned long long getLastUsedFrame(const Texture& texture);
+    static void evictTexture(CachedTexture& entry);
+    static void restoreTexture(const std::string& path, CachedTexture& entry);
+    // Evicts least recently used textures until the usage fits the budget
+    static void trimTextures();
 public:
+    // Copies of the texture stay valid for good, eviction never gives its GL name away
     static Texture& loadTexture(std::string path);
+    // Retained textures are never evicted, use it for textures that have to be ready without a reload hitch
+    static void retainTexture(const std::string& path);
+    static void releaseTexture(const std::string& path);
+    // Called by Texture::bind(), only stamps the frame. An evicted texture draws empty until updateTextures() reloads it
+    static void markTextureUsed(const Texture& texture);
+    // Reloads evicted textures that were bound since and evicts down to the budget. Runs at the start of each
+    // frame on the render thread, nothing else in the texture cache issues GL for existing textures
+    static void updateTextures(unsigned long long frame);
+    // Path the texture was loaded from, empty for textures not loaded through the manager
+    static std::string getTextureKey(const Texture& texture);
+
+    static size_t getTextureBudget() { return textureBudget; }
+    // Takes effect with the next updateTextures()
+    static void setTextureBudget(size_t bytes);
+    static unsigned long long getTextureEvictionCount() { return textureEvictions; }
+    static TextureCacheStats getTextureStats();
+
     static Shader& loadShader(std::string vertFilePath, std::string fragFilePath);
     static Shader& loadShader(std::string filePath, ShaderLoadType loadType);
+    // Compiled once per source pair and define set, order of the defines doesn't matter
+    static Shader& loadShaderVariant(const std::string& vertFilePath, const std::string& fragFilePath, std::vector<std::string> defines = {});
+    // Compiles variants up front, call it on a loading screen to avoid hitches on first use
+    static void warmShaderVariants(const std::string& vertFilePath, const std::string& fragFilePath, const std::vector<std::vector<std::string>>& defineSets);
+    static size_t getShaderVariantCount() { return cachedShaderVariants.size(); }
+    // "vert;frag" or the single path it was loaded with, empty for variants and shaders built elsewhere
+    static std::string getShaderKey(const Shader& shader);
 
     static void cleanAll();
 };
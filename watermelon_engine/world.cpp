@@ -1,8 +1,15 @@
 #include "world.hpp"
+#include "material.hpp"
+#include "debug_draw.hpp"
+#include <cstring>
 
 void WorldObject::update(float delta)
 {
-    globalPosition = position + (parent ? parent->getPosition() : glm::vec2{ 0 });
+    glm::vec2 newGlobalPosition = position + (parent ? parent->getPosition() : glm::vec2{ 0 });
+    if (newGlobalPosition != globalPosition) {
+        globalPosition = newGlobalPosition;
+        markDirty();
+    }
 
     for (const auto& addition : additions.getElements()) {
         addition.second.get()->update(delta);
@@ -27,16 +34,270 @@ void WorldObject::draw(Camera &camera)
     }
 }
 
+void WorldObject::record(DrawList &drawList)
+{
+    for (WorldObject* child : children) {
+        child->record(drawList);
+    }
+}
+
 void Sprite::update(float delta)
 {
     WorldObject::update(delta);
+
+    AnimationFrame* frame = animPlayer.isPlaying() ? animPlayer.getCurrentFrame() : nullptr;
     animPlayer.update(delta);
+    if (frame && frame != animPlayer.getCurrentFrame()) {
+        markDirty();
+    }
 }
 
 void Sprite::draw(Camera& camera)
 {
     glm::vec2 center = centered ? glm::vec2{ animPlayer.getSource().width * scale.x / 2, animPlayer.getSource().height * scale.y / 2 } : glm::vec2{ 0 };
-    animPlayer.draw(camera, globalPosition, scale, origin + center, rotation, shader, layerDepth, flipH, flipV);
+    Shader* drawShader = shader;
+    if (material) {
+        ObjectDrawer::useMaterial(material);
+        drawShader = material->getShader();
+    }
+    animPlayer.draw(camera, globalPosition, scale, origin + center, rotation, drawShader, layerDepth, flipH, flipV);
+
+    WorldObject::draw(camera);
+}
+
+void Sprite::record(DrawList &drawList)
+{
+    glm::vec2 center = centered ? glm::vec2{ animPlayer.getSource().width * scale.x / 2, animPlayer.getSource().height * scale.y / 2 } : glm::vec2{ 0 };
+    drawList.setMaterial(material);
+    animPlayer.record(drawList, globalPosition, scale, origin + center, rotation, material ? material->getShader() : shader, layerDepth, flipH, flipV);
+    drawList.setMaterial(nullptr);
+
+    WorldObject::record(drawList);
+}
+
+void YSortLayer::sort()
+{
+    // Children changed, start over from their current order
+    if (!hasSorted || sortedVersion != childrenVersion) {
+        entries.clear();
+        for (WorldObject* child : children) {
+            entries.push_back({ 0.f, child });
+        }
+        sortedVersion = childrenVersion;
+        hasSorted = true;
+    }
+
+    int descents = 0;
+    for (int i = 0; i < entries.size(); i++) {
+        entries[i].key = entries[i].object->getGlobalPosition().y;
+        if (i > 0 && entries[i].key < entries[i - 1].key) descents++;
+    }
+
+    if (descents == 0) {
+        lastSortWasRadix = false;
+        return;
+    }
+
+    lastSortWasRadix = descents > entries.size() * radixThreshold;
+    if (lastSortWasRadix) radixSort();
+    else insertionSort();
+}
+
+void YSortLayer::insertionSort()
+{
+    for (int i = 1; i < entries.size(); i++) {
+        Entry entry = entries[i];
+        int j = i - 1;
+        while (j >= 0 && entries[j].key > entry.key) {
+            entries[j + 1] = entries[j];
+            j--;
+        }
+        entries[j + 1] = entry;
+    }
+}
+
+void YSortLayer::radixSort()
+{
+    // Float bits are flipped so they compare as unsigned integers, then sorted by bytes (stable)
+    auto sortableKey = [](float key) {
+        unsigned int bits;
+        std::memcpy(&bits, &key, sizeof(bits));
+        return bits & 0x80000000u ? ~bits : bits | 0x80000000u;
+    };
+
+    radixBuffer.resize(entries.size());
+    std::vector<Entry>* source = &entries;
+    std::vector<Entry>* destination = &radixBuffer;
+
+    for (int shift = 0; shift < 32; shift += 8) {
+        unsigned int counts[257] = {};
+        for (const Entry& entry : *source) {
+            counts[((sortableKey(entry.key) >> shift) & 0xFF) + 1]++;
+        }
+        for (int i = 1; i < 257; i++) {
+            counts[i] += counts[i - 1];
+        }
+        for (const Entry& entry : *source) {
+            (*destination)[counts[(sortableKey(entry.key) >> shift) & 0xFF]++] = entry;
+        }
+        std::swap(source, destination);
+    }
+
+    // Four passes leave the result back in entries
+}
+
+void YSortLayer::draw(Camera &camera)
+{
+    sort();
+
+    for (const Entry& entry : entries) {
+        entry.object->draw(camera);
+    }
+}
+
+void YSortLayer::record(DrawList &drawList)
+{
+    sort();
+
+    for (const Entry& entry : entries) {
+        entry.object->record(drawList);
+    }
+}
+
+bool CachedLayer::needsRender(Camera &camera, glm::vec2 translation)
+{
+    if (!hasTarget || dirty) return true;
+    if (target.getWidth() != camera.getWidth() + margin * 2 || target.getHeight() != camera.getHeight() + margin * 2) return true;
+    if (camera.getZoom() != cachedZoom || camera.getRotation() != cachedRotation) return true;
+
+    glm::vec2 offset = glm::abs(translation - cachedTranslation);
+    return offset.x > margin || offset.y > margin;
+}
+
+void CachedLayer::render(Camera &camera, glm::vec2 translation)
+{
+    float width = camera.getWidth() + margin * 2;
+    float height = camera.getHeight() + margin * 2;
+    if (hasTarget && (target.getWidth() != width || target.getHeight() != height)) {
+        target.clean();
+        hasTarget = false;
+    }
+    if (!hasTarget) {
+        target = RenderTarget(width, height);
+        hasTarget = true;
+    }
+
+    // Same view shifted by the margin, so the cache also holds what is just outside the screen
+    Camera cacheCamera = camera;
+    cacheCamera.setWidth(width);
+    cacheCamera.setHeight(height);
+    cacheCamera.setOrigin(camera.getOrigin() + glm::vec2{ margin });
+
+    // The layer may be drawn into another target (e.g. DynamicResolution), so put that one back afterwards
+    int previousFramebuffer = 0;
+    int previousViewport[4];
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+    target.use();
+    glClearColor(0.f, 0.f, 0.f, 0.f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    WorldObject::draw(cacheCamera);
+    ObjectDrawer::flush();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+    glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+
+    cachedTranslation = translation;
+    cachedZoom = camera.getZoom();
+    cachedRotation = camera.getRotation();
+    dirty = false;
+    renderCount++;
+}
+
+void CachedLayer::draw(Camera &camera)
+{
+    glm::vec2 translation = camera.getOrigin() - camera.getPosition();
+    if (needsRender(camera, translation)) {
+        render(camera, translation);
+    }
+
+    // Scrolling inside the margin only moves the cached texture
+    Camera screen(camera.getWidth(), camera.getHeight());
+    target.draw(screen, translation - cachedTranslation - glm::vec2{ margin }, glm::vec2{ 1 }, glm::vec2{ 0 });
+}
+
+void CachedLayer::clean()
+{
+    if (!hasTarget) return;
+
+    target.clean();
+    hasTarget = false;
+    dirty = true;
+}
+
+void ParallaxLayer::updateSampler()
+{
+    if (!sampler) glGenSamplers(1, &sampler);
+
+    // Filtering follows the texture, only the wrapping is the layer's own
+    GLint minFilter, magFilter;
+    ObjectDrawer::flush(FLUSH_REASON_STATE);
+    glBindTexture(GL_TEXTURE_2D, texture.getId());
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, &minFilter);
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, &magFilter);
+    ObjectDrawer::resetState();
+
+    glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, minFilter);
+    glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, magFilter);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, repeatX ? wrapMode : GL_CLAMP_TO_EDGE);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, repeatY ? wrapMode : GL_CLAMP_TO_EDGE);
+    samplerDirty = false;
+}
+
+void ParallaxLayer::setWrap(int wrapMode, bool repeatX, bool repeatY)
+{
+    this->wrapMode = wrapMode;
+    this->repeatX = repeatX;
+    this->repeatY = repeatY;
+    samplerDirty = true;
+}
+
+void ParallaxLayer::clean()
+{
+    if (sampler) glDeleteSamplers(1, &sampler);
+    sampler = 0;
+    samplerDirty = true;
+}
+
+void ParallaxLayer::draw(Camera &camera)
+{
+    if (texture.getId()) {
+        // Rotation isn't followed, the layer always fills the screen upright
+        Rectangle view = camera.getVisibleBounds();
+        glm::vec2 tileSize = glm::vec2{ texture.getWidth(), texture.getHeight() } * scale;
+
+        // Where the screen corners land on the layer, in tiles
+        glm::vec2 start = (glm::vec2{ view.x, view.y } * factor - globalPosition + scroll) / tileSize;
+        glm::vec2 span = glm::vec2{ view.width, view.height } / tileSize;
+
+        // Keep coordinates small so far scrolling doesn't eat float precision, two tiles is a full mirrored period
+        if (repeatX) start.x = std::fmod(start.x, 2.f);
+        if (repeatY) start.y = std::fmod(start.y, 2.f);
+
+        UVRect uv;
+        uv.uv0 = glm::vec2{ start.x, 1.f - (start.y + span.y) };
+        uv.uv1 = glm::vec2{ start.x + span.x, 1.f - start.y };
+
+        if (samplerDirty) updateSampler();
+
+        Camera screen(camera.getWidth(), camera.getHeight());
+        glm::vec2 screenSize = glm::vec2{ camera.getWidth(), camera.getHeight() };
+        ObjectDrawer::flush(FLUSH_REASON_STATE);
+        glBindSampler(0, sampler);
+        ObjectDrawer::drawTexture(screen, texture, glm::vec2{ 0 }, glm::vec2{ 0 }, glm::vec2{ 1 }, 0.f, screenSize, uv, false, false, nullptr, layerDepth);
+        glBindSampler(0, 0);
+    }
 
     WorldObject::draw(camera);
 }
@@ -61,9 +322,13 @@ void PhysicalBodyAddition::physicsUpdate(float fixedDelta)
         if (collider.AABBvsAABB(collidersToCheck[dc.second], point, normal, velocity, collisionTime, fixedDelta)) {
             float remainingTime = 1.f - collisionTime;
             velocity += normal * glm::abs(velocity) * remainingTime;
+
+            DEBUG_DRAW_BOX(collidersToCheck[dc.second].getBounds(), Color{ 1.f, .3f, .3f });
+            DEBUG_DRAW_RAY(point, normal, 16.f, Color{ 1.f, 1.f, 0.f });
         }
     }
     
     owner->setPosition(owner->getPosition() + velocity * fixedDelta);
     collider.setPosition(owner->getPosition());
+    DEBUG_DRAW_BOX(collider.getBounds(), Color{ .3f, 1.f, .3f });
 }
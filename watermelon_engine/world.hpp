@@ -48,6 +48,8 @@ protected:
 
     WorldObject* parent = nullptr;
     std::vector<WorldObject*> children;
+    // Bumped whenever children are added or removed
+    unsigned int childrenVersion = 0;
 
     AdditionCollection additions;
 public:
@@ -70,8 +72,15 @@ public:
     inline void addChild(WorldObject* child) {
         child->setParent(this);
         children.push_back(child);
+        childrenVersion++;
+        markDirty();
     }
-    inline void removeChild(int index) { children.erase(children.begin() + index); }
+    inline void removeChild(int index) {
+        children.erase(children.begin() + index);
+        childrenVersion++;
+        markDirty();
+    }
+    inline unsigned int getChildrenVersion() const { return childrenVersion; }
 
     inline AdditionCollection& getAdditions() { return additions; }
     template<typename T>
@@ -81,9 +90,14 @@ public:
     template<typename T>
     T* getAddition() { return additions.get<T>(); }
 
+    // Tells cached ancestors that what this object draws has changed
+    virtual void markDirty() { if (parent) parent->markDirty(); }
+
     virtual void update(float delta);
     virtual void physicsUpdate(float fixedDelta);
     virtual void draw(Camera& camera);
+    // Camera independent counterpart of draw, the list can then be replayed for every camera
+    virtual void record(DrawList& drawList);
 };
 
 class Sprite : public WorldObject
@@ -98,10 +112,12 @@ private:
     float rotation;
     float layerDepth = 0;
 
-    bool flipH;
-    bool flipV;
+    bool flipH = false;
+    bool flipV = false;
 
     Shader* shader = nullptr;
+    // Takes the place of the shader when set
+    Material* material = nullptr;
 public:
     Sprite() = default;
     Sprite(AnimationPlayer animPlayer, glm::vec2 position, glm::vec2 origin, glm::vec2 scale, float rotation, bool centered)
@@ -111,39 +127,174 @@ public:
     Sprite(AnimationPlayer animPlayer, glm::vec2 position) : Sprite::Sprite(animPlayer, position, glm::vec2{ 1 }, 0) {}
 
     inline bool isVisible() { return visible; }
-    inline void setVisibility(bool visible) { this->visible = visible; }
+    inline void setVisibility(bool visible) { this->visible = visible; markDirty(); }
 
     inline AnimationPlayer& getAnimationPlayer() { return animPlayer; }
-    inline void setAnimationPlayer(const AnimationPlayer& animPlayer) { this->animPlayer = animPlayer; }
+    inline void setAnimationPlayer(const AnimationPlayer& animPlayer) { this->animPlayer = animPlayer; markDirty(); }
 
     // Get/Set transforms
     inline glm::vec2& getOrigin() { return origin; }
-    inline void setOrigin(const glm::vec2 origin) { this->origin = origin; }
+    inline void setOrigin(const glm::vec2 origin) { this->origin = origin; markDirty(); }
 
     inline bool isCentered() { return centered; }
-    inline void setCentered(bool centered) { this->centered = centered; }
+    inline void setCentered(bool centered) { this->centered = centered; markDirty(); }
 
     inline glm::vec2& getScale() { return scale; }
-    inline void setScale(const glm::vec2 scale) { this->scale = scale; }
+    inline void setScale(const glm::vec2 scale) { this->scale = scale; markDirty(); }
 
     inline float getRotation() { return rotation; }
-    inline void setRotation(float rotation) { this->rotation = rotation; }
+    inline void setRotation(float rotation) { this->rotation = rotation; markDirty(); }
 
     inline float getLayerDepth() { return layerDepth; }
-    inline void setLayerDepth(float layerDepth) { this->layerDepth = layerDepth; }
+    inline void setLayerDepth(float layerDepth) { this->layerDepth = layerDepth; markDirty(); }
 
     inline bool isFlippedH() { return flipH; }
-    inline void setFlipH(bool flipH) { this->flipH = flipH; }
+    inline void setFlipH(bool flipH) { this->flipH = flipH; markDirty(); }
 
     inline bool isFlippedV() { return flipV; }
-    inline void setFlipV(bool flipV) { this->flipV = flipV; }
+    inline void setFlipV(bool flipV) { this->flipV = flipV; markDirty(); }
     // ---------------
 
     inline Shader* getShader() { return shader; }
-    inline void setShader(Shader* shader) { this->shader = shader; }
+    inline void setShader(Shader* shader) { this->shader = shader; markDirty(); }
+
+    inline Material* getMaterial() { return material; }
+    inline void setMaterial(Material* material) { this->material = material; markDirty(); }
 
     virtual void update(float delta) override;
     virtual void draw(Camera& camera) override;
+    virtual void record(DrawList& drawList) override;
+};
+
+
+// Draws its children ordered by their global Y, so lower objects cover higher ones in top-down scenes.
+// The order is kept between frames and repaired with insertion sort, big reshuffles fall back to radix sort.
+class YSortLayer : public WorldObject
+{
+private:
+    struct Entry
+    {
+        float key;
+        WorldObject* object;
+    };
+
+    std::vector<Entry> entries;
+    std::vector<Entry> radixBuffer;
+    unsigned int sortedVersion = 0;
+    bool hasSorted = false;
+
+    // Share of out of order neighbours above which a radix sort is cheaper than repairing
+    float radixThreshold = .05f;
+    bool lastSortWasRadix = false;
+
+    void insertionSort();
+    void radixSort();
+public:
+    YSortLayer() = default;
+    YSortLayer(glm::vec2 position) : WorldObject::WorldObject(position) {}
+
+    inline float getRadixThreshold() const { return radixThreshold; }
+    inline void setRadixThreshold(float radixThreshold) { this->radixThreshold = radixThreshold; }
+    inline bool wasLastSortRadix() const { return lastSortWasRadix; }
+
+    void sort();
+
+    virtual void draw(Camera& camera) override;
+    virtual void record(DrawList& drawList) override;
+};
+
+
+// Renders its children into a texture once and then draws only that texture while nothing changes.
+// The cache covers the view plus a margin, it is re-rendered when a descendant is marked dirty or the camera
+// scrolls past the margin. Zooming or rotating the camera re-renders too, so keep it for layers that change rarely.
+// record() can run on worker threads that can't render, so it goes through the children as usual.
+class CachedLayer : public WorldObject
+{
+private:
+    RenderTarget target;
+    bool hasTarget = false;
+    bool dirty = true;
+
+    // Extra pixels rendered on every side of the view
+    float margin = 64.f;
+
+    // Camera state the cache was rendered with
+    glm::vec2 cachedTranslation = glm::vec2{ 0 };
+    float cachedZoom = 0.f;
+    float cachedRotation = 0.f;
+
+    int renderCount = 0;
+
+    bool needsRender(Camera& camera, glm::vec2 translation);
+    void render(Camera& camera, glm::vec2 translation);
+public:
+    CachedLayer() = default;
+    CachedLayer(glm::vec2 position, float margin = 64.f) : WorldObject::WorldObject(position), margin(margin) {}
+
+    inline float getMargin() const { return margin; }
+    inline void setMargin(float margin) { this->margin = margin; dirty = true; }
+
+    inline bool isDirty() const { return dirty; }
+    // Times the cache was re-rendered, handy to check that a layer really stays cached
+    inline int getRenderCount() const { return renderCount; }
+
+    virtual void markDirty() override {
+        dirty = true;
+        WorldObject::markDirty();
+    }
+
+    virtual void draw(Camera& camera) override;
+    void clean();
+};
+
+
+// Endless scrolling background drawn as one screen covering quad, the texture wraps instead of being tiled.
+// Factor 0 stays glued to the screen, 1 moves with the world, values between look further away.
+// It depends on the camera, so record() skips it and only goes through the children.
+class ParallaxLayer : public WorldObject
+{
+private:
+    Texture texture;
+    glm::vec2 factor = glm::vec2{ .5f };
+    // Extra scrolling in texture pixels, e.g. for clouds that drift on their own
+    glm::vec2 scroll = glm::vec2{ 0 };
+    glm::vec2 scale = glm::vec2{ 1 };
+    float layerDepth = 0;
+    // Vertical wrapping is usually unwanted for horizon layers
+    bool repeatX = true;
+    bool repeatY = true;
+    int wrapMode = GL_REPEAT;
+
+    // Own sampler so the wrap mode doesn't change the texture for everyone else sharing it
+    unsigned int sampler = 0;
+    bool samplerDirty = true;
+
+    void updateSampler();
+public:
+    ParallaxLayer() = default;
+    ParallaxLayer(Texture texture, glm::vec2 factor, float layerDepth = 0)
+        : WorldObject::WorldObject(glm::vec2{ 0 }), texture(texture), factor(factor), layerDepth(layerDepth) {}
+
+    inline Texture& getTexture() { return texture; }
+    inline void setTexture(Texture texture) { this->texture = texture; samplerDirty = true; }
+
+    inline glm::vec2 getFactor() const { return factor; }
+    inline void setFactor(glm::vec2 factor) { this->factor = factor; }
+
+    inline glm::vec2 getScroll() const { return scroll; }
+    inline void setScroll(glm::vec2 scroll) { this->scroll = scroll; }
+
+    inline glm::vec2 getScale() const { return scale; }
+    inline void setScale(glm::vec2 scale) { this->scale = scale; }
+
+    inline float getLayerDepth() const { return layerDepth; }
+    inline void setLayerDepth(float layerDepth) { this->layerDepth = layerDepth; }
+
+    inline int getWrapMode() const { return wrapMode; }
+    void setWrap(int wrapMode, bool repeatX, bool repeatY);
+
+    virtual void draw(Camera& camera) override;
+    void clean();
 };
 
 